@@ -1,14 +1,22 @@
 #include "esp_wifi.h"
 
 #include "osal.h"
+#include "power.h"
 #include "board.h"
 #include "RTC_time.h"
+#include "rtc_source.h"
+#include "console.h"
 
 enum tsk_e
 {
     TSK_BOARD_RX,
     TSK_BOARD_TX,
+    TSK_BOARD_BUS,
+    TSK_BOARD_CHIME,
     TSK_TIMER,
+    TSK_NTP,
+    TSK_GPS,
+    TSK_CONSOLE,
 
     TSK_ENUM_SIZE
 };
@@ -20,11 +28,31 @@ void app_start(void);
 const OSAL::Task::init_t tasks[TSK_ENUM_SIZE] = {
         [TSK_BOARD_RX] = { nullptr, 4096, "board_rx", 1 },
         [TSK_BOARD_TX] = { nullptr, 2048, "board_tx", 1 },
+        [TSK_BOARD_BUS]= { nullptr, 3072, "board_bus", 1 },
+        [TSK_BOARD_CHIME] = { nullptr, 3072, "chime", 1 },
         [TSK_TIMER]    = { nullptr, 4096, "timer", 2 },
+        [TSK_NTP]      = { nullptr, 4096, "ntp", 1 },
+        [TSK_GPS]      = { nullptr, 3072, "gps", 2 },
+        [TSK_CONSOLE]  = { nullptr, 3072, "console", 1 },
 };
 
 void timer_cb(tm& timeinfo)
 {
+    // the dial is also redrawn on sync and zone change, chime once per hour
+    static int chimed_hour = -1;
+    if (timeinfo.tm_min == 0 and timeinfo.tm_hour != chimed_hour)
+    {
+        board_msg_t chime
+        {
+            .event = BOARD_CHIME_PLAY,
+            .u = {
+                    .value = 0,
+            }
+        };
+        board_cb(&chime);
+    }
+    chimed_hour = timeinfo.tm_min == 0 ? timeinfo.tm_hour : -1;
+
     board_msg_t msg
     {
         .event = BOARD_DIAL_SET_TIME,
@@ -36,11 +64,71 @@ void timer_cb(tm& timeinfo)
     board_cb(&msg);
 }
 
+void alarm_cb(uint8_t id, uint8_t melody)
+{
+    (void)id;
+    board_msg_t msg
+    {
+        .event = BOARD_BUZZER_PLAY,
+        .u = {
+                .value = melody,
+        }
+    };
+
+    board_cb(&msg);
+}
+
+void stop_cb()
+{
+    board_msg_t msg
+    {
+        .event = BOARD_BUZZER_STOP,
+        .u = {},
+    };
+
+    board_cb(&msg);
+}
+
+void dismiss_cb()
+{
+    stop_cb();
+
+    timer_msg_t msg
+    {
+        .event = TIMER_DISMISS,
+        .u = {},
+    };
+
+    timer_cb(&msg);
+}
+
+void snooze_cb()
+{
+    // a click outside of a ring stops a chime, the snooze itself is ignored
+    stop_cb();
+
+    timer_msg_t msg
+    {
+        .event = TIMER_SNOOZE,
+        .u = {},
+    };
+
+    timer_cb(&msg);
+}
+
 void app_start() {
+    power_init();
     ESP_ERROR_CHECK(esp_netif_init());
 
-    board_init(tasks[TSK_BOARD_RX], tasks[TSK_BOARD_RX]);
-    timer_init(tasks[TSK_TIMER]);
+    board_init(tasks[TSK_BOARD_RX], tasks[TSK_BOARD_TX], tasks[TSK_BOARD_BUS], tasks[TSK_BOARD_CHIME]);
+    // the RTC shares the expander's bus, its owner task does the transfers
+    rtc_source_attach(board_bus_read, board_bus_write);
+    timer_init(tasks[TSK_TIMER], tasks[TSK_NTP], tasks[TSK_GPS]);
+    console_init(tasks[TSK_CONSOLE]);
 
     timer_register_cb(TIMER_SET_TIME, timer_cb);
+    timer_register_alarm_cb(alarm_cb);
+
+    board_register_cb(BOARD_BTN1_SINGLE_CLICK, snooze_cb);
+    board_register_cb(BOARD_BTN1_DOUBLE_CLICK, dismiss_cb);
 }
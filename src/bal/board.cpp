@@ -1,25 +1,62 @@
 #include <array>
 #include <vector>
 
+#include <sys/time.h>
+
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "nvs_flash.h"
 
 #include "board.h"
 #include "mcp23017.h"
+#include "expander.h"
 #include "dial.h"
+#include "nixie.h"
 #include "buttons.h"
+#include "buzzer.h"
+#include "chime.h"
 
 #define I2C_SDA_IO 14
 #define I2C_SCL_IO 15
 
 #define MAX_CALLBACKS 5
 
+#define BLINK_DEFAULT_DUTY 50  ///< separators lit for the first half of every second, layouts with a ':' only
+
+#define BUTTON_NUM         3
+#define BUTTON_DEBOUNCE_MS 30   ///< level has to hold this long to count
+#define BUTTON_DOUBLE_MS   300  ///< second click within this time makes a double click
+
 static const char *TAG = "BOARD";
 
+static constexpr auto nixie_lut = nixie_desc.lut();
+
+// BOARD_BUZZER_PLAY value picks the melody
+static const struct {
+    const char* rtttl;
+    bool        loop;
+} melodies[] = {
+        {"beep:d=16,o=6,b=120:c7", false},
+        {"alarm:d=8,o=6,b=140:c7,p,c7,p,c7,p,c7,2p", true},
+        {"chime:d=4,o=5,b=100:e6,c6,d6,2g5,g5,d6,e6,2c6", false},
+        {"wake:d=8,o=6,b=125:c,e,g,c7,4p,c7,g,e,c,2p", true},
+};
+static_assert(sizeof(melodies) / sizeof(melodies[0]) <= BUZZER_MELODIES, "Too many melodies");
+
 static std::array<std::pair<board_event_t, board_cb_t>, MAX_CALLBACKS> callbacks;
 static size_t callback_num = 0;
 
+static const gpio_num_t button_ports[BUTTON_NUM] = {GPIO_NUM_12, GPIO_NUM_13, GPIO_NUM_14};
+static_assert(BOARD_BTN2_SINGLE_CLICK == BOARD_BTN1_SINGLE_CLICK + 2 and BOARD_BTN3_SINGLE_CLICK == BOARD_BTN2_SINGLE_CLICK + 2,
+              "Button events are expected as single/double pairs");
+
 static class BoardRx* _task_rx = nullptr;
+static class BoardTx* _task_tx = nullptr;
+static Expander*      _expander = nullptr;
+static Chime*         _chime = nullptr;
+
+static esp_timer_handle_t _blink_timer = nullptr;
+static uint8_t            _blink_duty  = BLINK_DEFAULT_DUTY;
 
 class BoardRx final : public OSAL::Task
 {
@@ -27,11 +64,11 @@ public:
     OSAL::Queue<board_msg_t, 10> m_queue {nullptr};
 
 private:
-    mcp23017_t mcp_cfg;
-    Dial       dial;
+    Dial   dial;
+    Buzzer buzzer;
 
 public:
-    explicit BoardRx() noexcept : OSAL::Task{} {}
+    explicit BoardRx(Expander* expander) noexcept : OSAL::Task{}, dial{expander, nixie_lut, nixie_layout} {}
 
 private:
     void setup() noexcept final;
@@ -42,7 +79,23 @@ private:
 class BoardTx final : public OSAL::Task
 {
 private:
+    struct button_state_t {
+        uint8_t id;           ///< button number, picks the board events
+        bool    pressed;
+        bool    settling;     ///< level changed, waiting for the bounce to end
+        uint8_t clicks;       ///< clicks waiting to be reported
+        int64_t deadline_us;  ///< end of bounce or double click wait, 0 - none
+    };
+
+    // a button stays disarmed until its item is handled, so the queue never overflows
+    OSAL::Queue<uint8_t, BUTTON_NUM> m_queue {nullptr};
+
     std::vector<Button> buttons;
+    button_state_t      m_state[BUTTON_NUM] = {};
+
+    static void isr_adapter(void* arg);
+    void on_deadline(size_t idx, int64_t now_us) noexcept;
+    void emit(size_t idx, bool twice) noexcept;
 
 public:
     explicit BoardTx() noexcept : OSAL::Task{} {}
@@ -53,54 +106,121 @@ private:
     void teardown() noexcept final;
 };
 
-static bool init_mcp23017(mcp23017_t* mcp_cfg)
+/**
+ * @brief separator blink, re-armed on every edge from the system clock
+ *
+ * Lit from the second boundary for `_blink_duty` percent of the second,
+ * so the blink stays phase-locked to the clock through SNTP steps.
+ */
+static void blink_cb(void*)
 {
-    mcp_cfg->i2c_addr = 0x20;
-    mcp_cfg->port = I2C_NUM_1;
-    mcp_cfg->sda_pin = I2C_SDA_IO;
-    mcp_cfg->scl_pin = I2C_SCL_IO;
-    mcp_cfg->sda_pullup_en = GPIO_PULLUP_ENABLE;
-    mcp_cfg->scl_pullup_en = GPIO_PULLUP_ENABLE;
+    timeval tv;
+    gettimeofday(&tv, nullptr);
+
+    int64_t duty_us = _blink_duty * 10000LL;
+    bool    on      = tv.tv_usec < duty_us;
 
-    if (ESP_OK != mcp23017_init(mcp_cfg))
+    board_msg_t msg {
+        .event = BOARD_DIAL_SET_DOT,
+        .u = {
+            .value = on,
+        }
+    };
+    if (not _task_rx->m_queue.send(&msg, 0))
     {
-        ESP_LOGE(TAG, "Could not initialise mcp23017!");
-        return false;
+        ESP_LOGW(TAG, "Blink dropped, event queue full");
     }
 
-    bool ret;
-    ret =    not mcp23017_write_register(mcp_cfg, MCP23017_IODIR, GPIOA, 0x0);
-    ret = ret || mcp23017_write_register(mcp_cfg, MCP23017_IODIR, GPIOB, 0x0);
-    ret = ret || mcp23017_write_register(mcp_cfg, MCP23017_GPPU, GPIOA, 0x0);
-    ret = ret || mcp23017_write_register(mcp_cfg, MCP23017_GPPU, GPIOB, 0x0);
+    int64_t next_us = on ? duty_us - tv.tv_usec : 1000000 - tv.tv_usec;
+    esp_timer_start_once(_blink_timer, next_us);
+}
+
+static void blink_start(uint8_t duty)
+{
+    _blink_duty = duty;
+    if (not _blink_timer)
+    {
+        const esp_timer_create_args_t args {
+            .callback        = blink_cb,
+            .dispatch_method = ESP_TIMER_TASK,
+            .name            = "blink",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&args, &_blink_timer));
+    }
+
+    esp_timer_stop(_blink_timer);
+    if (duty > 0 and duty < 100)
+        esp_timer_start_once(_blink_timer, 0);
+}
+
+static mcp23017_t mcp23017_config()
+{
+    mcp23017_t mcp_cfg {};
+    mcp_cfg.i2c_addr = 0x20;
+    mcp_cfg.port = I2C_NUM_1;
+    mcp_cfg.sda_pin = I2C_SDA_IO;
+    mcp_cfg.scl_pin = I2C_SCL_IO;
+    mcp_cfg.sda_pullup_en = GPIO_PULLUP_ENABLE;
+    mcp_cfg.scl_pullup_en = GPIO_PULLUP_ENABLE;
+    return mcp_cfg;
+}
+
+static bool init_mcp23017(Expander* expander)
+{
+    const expander_txn_t init[] = {
+            { .op = EXPANDER_WRITE, .reg = MCP23017_IODIR, .group = GPIOA, .value = 0x0 },
+            { .op = EXPANDER_WRITE, .reg = MCP23017_IODIR, .group = GPIOB, .value = 0x0 },
+            { .op = EXPANDER_WRITE, .reg = MCP23017_GPPU,  .group = GPIOA, .value = 0x0 },
+            { .op = EXPANDER_WRITE, .reg = MCP23017_GPPU,  .group = GPIOB, .value = 0x0 },
+    };
+
+    bool ret = true;
+    for (const auto& txn: init)
+    {
+        ret = ret and expander->submit(txn, UINT32_MAX);
+    }
 
     return ret;
 }
 
 void BoardRx::setup() noexcept
 {
-    if (not init_mcp23017(&mcp_cfg))
+    if (not init_mcp23017(_expander))
     {
         ESP_LOGE(TAG, "Error initializing i2c");
     }
 
-    dial.add_lamp(&mcp_cfg, 0xF0, GPIOA);
-    dial.add_lamp(&mcp_cfg, 0x0F, GPIOB);
-    dial.add_lamp(&mcp_cfg, 0xF0, GPIOB);
-    dial.add_lamp(&mcp_cfg, 0x0F, GPIOA);
+    nvs_flash_init();
+    dial.restore_usage();
+
+    // the blink timer would only wake the chip for nothing without a separator, as with nixie_layout
+    if (dial.has_dots())
+        blink_start(_blink_duty);
+
+    if (buzzer.start())
+    {
+        for (uint8_t id = 0; id < sizeof(melodies) / sizeof(melodies[0]); id++)
+            buzzer.load(id, melodies[id].rtttl, melodies[id].loop);
+    }
 }
 
 void BoardRx::run() noexcept
 {
     while (1) {
         board_msg_t msg;
-        if (m_queue.receive(&msg, 0))
+        if (m_queue.receive(&msg, UINT32_MAX))
         {
             switch (msg.event) {
 
                 case BOARD_DIAL_SET_TIME:
                 {
-                    dial.set_time(msg.u.timeinfo);
+                    dial_update_t ret = dial.update_time(msg.u.timeinfo);
+                    if (not ret.ok)
+                    {
+                        _expander->log_health();
+                    }
+                    ESP_LOGD(TAG, "Time update: lamps 0x%02x changed, %u bus ops", ret.changed, ret.bus_ops);
+                    dial.log_stats();
                     break;
                 }
                 case BOARD_LAMP1_SET_VALUE:
@@ -123,14 +243,51 @@ void BoardRx::run() noexcept
                     dial.set_lamp_value(3, msg.u.value);
                     break;
                 }
+                case BOARD_DIAL_SET_BRIGHTNESS:
+                {
+                    dial.set_brightness(msg.u.value);
+                    break;
+                }
+                case BOARD_DIAL_SET_TRANSITION:
+                {
+                    if (msg.u.value < DIAL_TRANSITION_NUM)
+                        dial.set_transition(static_cast<dial_transition_t>(msg.u.value));
+                    break;
+                }
+                case BOARD_DIAL_SET_DOT:
+                {
+                    dial.set_dot(msg.u.value);
+                    break;
+                }
+                case BOARD_DIAL_SET_BLINK:
+                {
+                    if (not dial.has_dots())
+                    {
+                        ESP_LOGW(TAG, "No separators to blink");
+                        break;
+                    }
+                    // 0 - separators off, 100 - always on
+                    uint8_t duty = msg.u.value > 100 ? 100 : msg.u.value;
+                    dial.set_dot(duty);
+                    blink_start(duty);
+                    break;
+                }
                 case BOARD_BUZZER_PLAY:
                 {
-                    ESP_LOGW(TAG, "Buzzer play mock");
+                    if (not buzzer.play(msg.u.value))
+                        ESP_LOGW(TAG, "No melody %u", msg.u.value);
                     break;
                 }
                 case BOARD_BUZZER_STOP:
                 {
-                    ESP_LOGW(TAG, "Buzzer stop mock");
+                    buzzer.stop();
+                    (void)_chime->stop();
+                    break;
+                }
+                case BOARD_CHIME_PLAY:
+                {
+                    if (not _chime->play(msg.u.value))
+                        ESP_LOGW(TAG, "Chime %u dropped", msg.u.value);
                     break;
                 }
                 case BOARD_BTN1_SINGLE_CLICK:
@@ -143,7 +300,6 @@ void BoardRx::run() noexcept
                     break;
             }
         }
-        vTaskDelay(pdMS_TO_TICKS(500));
     }
 }
 
@@ -151,40 +307,158 @@ void BoardRx::teardown() noexcept
 {
     m_queue.~Queue();
     dial.~Dial();
+    buzzer.stop();
+}
+
+void BoardTx::isr_adapter(void* arg)
+{
+    uint8_t idx = reinterpret_cast<uintptr_t>(arg);
+
+    // level interrupt keeps firing while the level holds, the task re-arms it once settled
+    _task_tx->buttons[idx].disarm();
+    (void)_task_tx->m_queue.send_from_isr(&idx);
+}
+
+void BoardTx::emit(size_t idx, bool twice) noexcept
+{
+    uint8_t id    = m_state[idx].id;
+    auto    event = static_cast<board_event_t>(BOARD_BTN1_SINGLE_CLICK + 2 * id + twice);
+    ESP_LOGD(TAG, "Button %u %s click", (unsigned)id + 1, twice ? "double" : "single");
+
+    for (size_t i = 0; i < callback_num; i++)
+    {
+        if (callbacks[i].first == event)
+            callbacks[i].second();
+    }
+}
+
+void BoardTx::on_deadline(size_t idx, int64_t now_us) noexcept
+{
+    button_state_t& state = m_state[idx];
+    state.deadline_us = 0;
+
+    if (not state.settling)
+    {
+        // no second click in time
+        if (state.clicks and not state.pressed)
+            emit(idx, false);
+        state.clicks = 0;
+        return;
+    }
+
+    state.settling = false;
+    bool pressed = buttons[idx].is_pressed();
+    if (pressed != state.pressed)
+    {
+        state.pressed = pressed;
+        if (not pressed and ++state.clicks >= 2)
+        {
+            emit(idx, true);
+            state.clicks = 0;
+        }
+    }
+
+    if (state.clicks and not state.pressed)
+        state.deadline_us = now_us + BUTTON_DOUBLE_MS * 1000;
+    buttons[idx].arm(state.pressed);
 }
 
 void BoardTx::setup() noexcept
 {
     nvs_flash_init();
 
-    buttons.emplace_back(GPIO_NUM_12);
-    buttons.emplace_back(GPIO_NUM_13);
-    buttons.emplace_back(GPIO_NUM_14);
+    buttons.reserve(BUTTON_NUM);
+    for (uint8_t id = 0; id < BUTTON_NUM; id++)
+    {
+        // reconfiguring a bus line would break the expander
+        if (button_ports[id] == I2C_SDA_IO or button_ports[id] == I2C_SCL_IO)
+        {
+            ESP_LOGW(TAG, "Button %u shares GPIO %d with I2C, not used", (unsigned)id + 1, button_ports[id]);
+            continue;
+        }
+
+        size_t idx = buttons.size();
+        buttons.emplace_back(button_ports[id]);
+        m_state[idx].id      = id;
+        m_state[idx].pressed = buttons[idx].is_pressed();
+    }
+    for (size_t idx = 0; idx < buttons.size(); idx++)
+    {
+        if (not buttons[idx].attach(isr_adapter, reinterpret_cast<void*>(idx)))
+            ESP_LOGE(TAG, "Button %u won't respond", (unsigned)m_state[idx].id + 1);
+    }
 }
 
 void BoardTx::run() noexcept
 {
+    const int64_t tick_us = portTICK_PERIOD_MS * 1000;
+
+    // sleeps on the queue until a button interrupt or the nearest debounce/click deadline
     while (1) {
-//        if()
-        vTaskDelay(pdMS_TO_TICKS(500));
+        int64_t next_us = 0;
+        for (const auto& state: m_state)
+        {
+            if (state.deadline_us and (not next_us or state.deadline_us < next_us))
+                next_us = state.deadline_us;
+        }
+
+        uint32_t wait_ms = UINT32_MAX;
+        if (next_us)
+        {
+            int64_t left_us = next_us - esp_timer_get_time();
+            wait_ms = left_us > 0 ? static_cast<uint32_t>((left_us / tick_us + 1) * portTICK_PERIOD_MS) : 0;
+        }
+
+        uint8_t idx;
+        if (m_queue.receive(&idx, wait_ms))
+        {
+            if (idx < buttons.size())
+            {
+                m_state[idx].settling    = true;
+                m_state[idx].deadline_us = esp_timer_get_time() + BUTTON_DEBOUNCE_MS * 1000;
+            }
+            continue;
+        }
+
+        int64_t now_us = esp_timer_get_time();
+        for (size_t i = 0; i < buttons.size(); i++)
+        {
+            if (m_state[i].deadline_us and m_state[i].deadline_us <= now_us)
+                on_deadline(i, now_us);
+        }
     }
 }
 
 void BoardTx::teardown() noexcept
 {
-
+    for (auto& button: buttons)
+        button.disarm();
 }
 
-void board_init(const OSAL::Task::init_t& rx_init, const OSAL::Task::init_t& tx_init)
+void board_init(const OSAL::Task::init_t& rx_init, const OSAL::Task::init_t& tx_init,
+                const OSAL::Task::init_t& bus_init, const OSAL::Task::init_t& chime_init)
 {
+    static std::aligned_storage_t<sizeof(Expander), alignof(Expander)> _expander_storage;
     static std::aligned_storage_t<sizeof(BoardRx), alignof(BoardRx)> _task_rx_storage;
+    static std::aligned_storage_t<sizeof(Chime), alignof(Chime)> _chime_storage;
+
+    assert(not _expander);
+    _expander = new(&_expander_storage) Expander{mcp23017_config()};
+    bool ret = _expander->start(bus_init);
+    assert(ret);
+
+    assert(not _chime);
+    _chime = new(&_chime_storage) Chime{};
+    ret = _chime->start(chime_init);
+    assert(ret);
 
     assert(not _task_rx);
-    _task_rx = new(&_task_rx_storage) BoardRx{};
-    bool ret = _task_rx->start(rx_init);
+    _task_rx = new(&_task_rx_storage) BoardRx{_expander};
+    ret = _task_rx->start(rx_init);
     assert(ret);
 
     static BoardTx tx{};
+    _task_tx = &tx;
     ret = tx.start(tx_init);
     assert(ret);
 
@@ -209,6 +483,49 @@ bool board_register_cb(board_event_t on_event, board_cb_t func)
     return true;
 }
 
+static esp_err_t bus_err(mcp23017_err_t err)
+{
+    switch (err)
+    {
+        case MCP23017_ERR_OK:
+            return ESP_OK;
+        case MCP23017_ERR_FAIL:
+            return ESP_FAIL;
+        case MCP23017_ERR_TIMEOUT:
+            return ESP_ERR_TIMEOUT;
+        default:
+            return ESP_ERR_INVALID_STATE;
+    }
+}
+
+esp_err_t board_bus_read(uint8_t device, uint8_t reg, uint8_t* data, size_t len)
+{
+    if (not _expander or len > UINT8_MAX)
+        return ESP_ERR_INVALID_STATE;
+
+    expander_txn_t txn {};
+    txn.op         = EXPANDER_DEVICE_READ;
+    txn.device     = device;
+    txn.device_reg = reg;
+    txn.buf        = data;
+    txn.len        = static_cast<uint8_t>(len);
+    return bus_err(_expander->execute(txn));
+}
+
+esp_err_t board_bus_write(uint8_t device, uint8_t reg, const uint8_t* data, size_t len)
+{
+    if (not _expander or len > UINT8_MAX)
+        return ESP_ERR_INVALID_STATE;
+
+    expander_txn_t txn {};
+    txn.op         = EXPANDER_DEVICE_WRITE;
+    txn.device     = device;
+    txn.device_reg = reg;
+    txn.data       = data;
+    txn.len        = static_cast<uint8_t>(len);
+    return bus_err(_expander->execute(txn));
+}
+
 void board_cb(board_msg_t* msg)
 {
     if (not _task_rx){
@@ -2,6 +2,10 @@
 
 
 #include "driver/gpio.h"
+#include "esp_log.h"
+#include "esp_sleep.h"
+
+static const char *TAG = "BUTTONS";
 
 Button::Button(gpio_num_t port) noexcept
 {
@@ -9,13 +13,42 @@ Button::Button(gpio_num_t port) noexcept
 
     gpio_set_direction(m_port, GPIO_MODE_INPUT);
     gpio_set_pull_mode(m_port, GPIO_PULLUP_ONLY);
-    gpio_set_intr_type(m_port, GPIO_INTR_NEGEDGE);
+    gpio_intr_disable(m_port);
+}
+
+bool Button::attach(gpio_isr_t isr, void* arg) noexcept
+{
+    static bool service = false;
+    if (not service)
+    {
+        esp_err_t ret = gpio_install_isr_service(0);
+        if (ret != ESP_OK and ret != ESP_ERR_INVALID_STATE)
+        {
+            ESP_LOGE(TAG, "Could not install GPIO interrupt service");
+            return false;
+        }
+        esp_sleep_enable_gpio_wakeup();
+        service = true;
+    }
+
+    if (ESP_OK != gpio_isr_handler_add(m_port, isr, arg))
+    {
+        ESP_LOGE(TAG, "Could not attach button on GPIO %d", m_port);
+        return false;
+    }
+
+    arm(is_pressed());
+    return true;
+}
+
+void Button::arm(bool pressed) noexcept
+{
+    // only level interrupts can wake from light sleep, this also sets the interrupt type
+    gpio_wakeup_enable(m_port, pressed ? GPIO_INTR_HIGH_LEVEL : GPIO_INTR_LOW_LEVEL);
     gpio_intr_enable(m_port);
-//    gpio_isr_register(intr_cb, (void *) "Test", 0, nullptr);
-//    esp_intr_alloc(ETS_GPIO_INTR_SOURCE, 0, intr_cb, (void *) "Test", NULL);
 }
 
 bool Button::is_pressed() const
 {
-    return gpio_get_level(m_port);
+    return not gpio_get_level(m_port);
 }
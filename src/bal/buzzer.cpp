@@ -2,4 +2,323 @@
 // Created by himiki on 17.05.24.
 //
 
+#include <cctype>
+#include <cstdlib>
+
+#include "esp_log.h"
+
 #include "buzzer.h"
+
+static const char *TAG = "BUZZER";
+
+/**
+ * @brief frequencies of the 8th octave, C8 .. B8; lower octaves are halves
+ */
+static constexpr uint16_t octave8_hz[12] = {4186, 4435, 4699, 4978, 5274, 5588, 5920, 6272, 6645, 7040, 7459, 7902};
+
+/**
+ * @brief semitone of a note letter, a .. g
+ */
+static constexpr int8_t letter_semitone[7] = {9, 11, 0, 2, 4, 5, 7};
+
+static const char* parse_uint(const char* pos, unsigned& out)
+{
+    out = 0;
+    while (isdigit(static_cast<unsigned char>(*pos)))
+        out = out * 10 + (*pos++ - '0');
+    return pos;
+}
+
+size_t Buzzer::parse_rtttl(const char* rtttl, buzzer_note_t* out, size_t max) noexcept
+{
+    // name
+    const char* pos = rtttl;
+    while (*pos and *pos != ':')
+        pos++;
+    if (not *pos++)
+        return 0;
+
+    // defaults
+    unsigned duration = 4, octave = 6, bpm = 63;
+    while (*pos and *pos != ':')
+    {
+        char key = static_cast<char>(tolower(static_cast<unsigned char>(*pos)));
+        unsigned value;
+        if (pos[1] != '=')
+            return 0;
+        pos = parse_uint(pos + 2, value);
+        if (key == 'd' and value)
+            duration = value;
+        else if (key == 'o')
+            octave = value;
+        else if (key == 'b' and value)
+            bpm = value;
+        while (*pos == ',' or *pos == ' ')
+            pos++;
+    }
+    if (not *pos++)
+        return 0;
+
+    // a whole note is four beats
+    const uint32_t whole_ms = 4 * 60000 / bpm;
+    size_t num = 0;
+    while (*pos and num < max)
+    {
+        while (*pos == ' ')
+            pos++;
+
+        unsigned note_duration;
+        pos = parse_uint(pos, note_duration);
+        if (not note_duration)
+            note_duration = duration;
+
+        char letter = static_cast<char>(tolower(static_cast<unsigned char>(*pos++)));
+        int semitone = -1;
+        if (letter >= 'a' and letter <= 'g')
+            semitone = letter_semitone[letter - 'a'];
+        else if (letter != 'p')
+            return 0;
+        if (*pos == '#')
+        {
+            semitone++;
+            pos++;
+        }
+
+        bool dotted = false;
+        if (*pos == '.')
+        {
+            dotted = true;
+            pos++;
+        }
+        unsigned note_octave;
+        const char* after = parse_uint(pos, note_octave);
+        if (after == pos)
+            note_octave = octave;
+        pos = after;
+        // both "4e.6" and "4e6." are in the wild
+        if (*pos == '.')
+        {
+            dotted = true;
+            pos++;
+        }
+
+        uint32_t ms = whole_ms / note_duration;
+        if (dotted)
+            ms += ms / 2;
+
+        uint16_t freq = 0;
+        if (semitone >= 0)
+        {
+            // b# is c of the next octave
+            if (semitone == 12)
+            {
+                semitone = 0;
+                note_octave++;
+            }
+            note_octave = note_octave < 3 ? 3 : note_octave > 8 ? 8 : note_octave;
+            freq = octave8_hz[semitone] >> (8 - note_octave);
+        }
+        out[num++] = {freq, static_cast<uint16_t>(ms > UINT16_MAX ? UINT16_MAX : ms)};
+
+        while (*pos == ',' or *pos == ' ')
+            pos++;
+    }
+    return num;
+}
+
+void Buzzer::step_adapter(void* ctx)
+{
+    static_cast<Buzzer*>(ctx)->step();
+}
+
+void Buzzer::tone(uint16_t freq_hz) noexcept
+{
+    if (freq_hz)
+        ledc_set_freq(BUZZER_LEDC_MODE, BUZZER_LEDC_TIMER, freq_hz);
+    ledc_set_duty(BUZZER_LEDC_MODE, BUZZER_LEDC_CH, freq_hz ? 1 << (BUZZER_DUTY_BITS - 1) : 0);
+    ledc_update_duty(BUZZER_LEDC_MODE, BUZZER_LEDC_CH);
+}
+
+void Buzzer::finished() noexcept
+{
+    if (m_pm_lock)
+        esp_pm_lock_release(m_pm_lock);
+}
+
+void Buzzer::step() noexcept
+{
+    uint16_t freq = 0;
+    uint32_t ms   = 0;
+    bool     done = false;
+
+    portENTER_CRITICAL(&m_lock);
+    if (m_melody and m_gap)
+    {
+        m_gap = false;
+        ms    = BUZZER_GAP_MS;
+    }
+    else if (m_melody)
+    {
+        if (m_pos >= m_melody->len)
+        {
+            m_pos = 0;
+            if (not m_melody->loop or esp_timer_get_time() >= m_until_us)
+            {
+                m_melody = nullptr;
+                done     = true;
+            }
+        }
+        if (m_melody)
+        {
+            const buzzer_note_t& note = m_melody->notes[m_pos++];
+            freq = note.freq_hz;
+            ms   = note.ms;
+            if (freq and ms > 2 * BUZZER_GAP_MS)
+            {
+                ms   -= BUZZER_GAP_MS;
+                m_gap = true;
+            }
+        }
+    }
+    bool playing = m_melody;
+    portEXIT_CRITICAL(&m_lock);
+
+    tone(freq);
+    if (done)
+        finished();
+    if (not playing)
+        return;
+
+    // a stop in between has already silenced the channel, don't sound it again
+    portENTER_CRITICAL(&m_lock);
+    playing = m_melody;
+    portEXIT_CRITICAL(&m_lock);
+    if (not playing)
+    {
+        tone(0);
+        return;
+    }
+    esp_timer_start_once(m_timer, ms * 1000);
+}
+
+Buzzer::~Buzzer() noexcept
+{
+    if (not m_timer)
+        return;
+
+    stop();
+    esp_timer_delete(m_timer);
+    if (m_pm_lock)
+        esp_pm_lock_delete(m_pm_lock);
+}
+
+bool Buzzer::start() noexcept
+{
+    if (m_timer)
+        return true;
+
+    const ledc_timer_config_t timer {
+        .speed_mode      = BUZZER_LEDC_MODE,
+        .duty_resolution = BUZZER_DUTY_BITS,
+        .timer_num       = BUZZER_LEDC_TIMER,
+        .freq_hz         = 1000,
+        .clk_cfg         = LEDC_AUTO_CLK,
+    };
+    const ledc_channel_config_t channel {
+        .gpio_num   = BUZZER_IO,
+        .speed_mode = BUZZER_LEDC_MODE,
+        .channel    = BUZZER_LEDC_CH,
+        .intr_type  = LEDC_INTR_DISABLE,
+        .timer_sel  = BUZZER_LEDC_TIMER,
+        .duty       = 0,
+        .hpoint     = 0,
+    };
+    if (ESP_OK != ledc_timer_config(&timer) or ESP_OK != ledc_channel_config(&channel))
+    {
+        ESP_LOGE(TAG, "Could not configure LEDC");
+        return false;
+    }
+
+    const esp_timer_create_args_t args {
+        .callback              = step_adapter,
+        .arg                   = this,
+        .dispatch_method       = ESP_TIMER_TASK,
+        .name                  = "buzzer",
+        .skip_unhandled_events = true,
+    };
+    if (ESP_OK != esp_timer_create(&args, &m_timer))
+    {
+        ESP_LOGE(TAG, "Could not create buzzer timer");
+        m_timer = nullptr;
+        return false;
+    }
+
+    // LEDC runs from the APB clock, frequency scaling would drop the pitch; the lock keeps light sleep off too
+    if (ESP_OK != esp_pm_lock_create(ESP_PM_APB_FREQ_MAX, 0, "buzzer", &m_pm_lock))
+    {
+        ESP_LOGW(TAG, "Could not hold the APB clock, tones may break up");
+        m_pm_lock = nullptr;
+    }
+    return true;
+}
+
+bool Buzzer::load(uint8_t id, const char* rtttl, bool loop) noexcept
+{
+    if (id >= BUZZER_MELODIES)
+        return false;
+
+    buzzer_note_t notes[BUZZER_MAX_NOTES];
+    size_t len = parse_rtttl(rtttl, notes, BUZZER_MAX_NOTES);
+    if (not len)
+    {
+        ESP_LOGE(TAG, "Malformed melody %u", id);
+        return false;
+    }
+
+    // the slot may be playing right now
+    stop();
+    melody_t& melody = m_melodies[id];
+    for (size_t i = 0; i < len; i++)
+        melody.notes[i] = notes[i];
+    melody.len  = static_cast<uint8_t>(len);
+    melody.loop = loop;
+    return true;
+}
+
+bool Buzzer::play(uint8_t id) noexcept
+{
+    if (not m_timer or id >= BUZZER_MELODIES or not m_melodies[id].len)
+        return false;
+
+    portENTER_CRITICAL(&m_lock);
+    bool was_playing = m_melody;
+    m_melody   = &m_melodies[id];
+    m_pos      = 0;
+    m_gap      = false;
+    m_until_us = esp_timer_get_time() + BUZZER_RING_S * 1000000LL;
+    portEXIT_CRITICAL(&m_lock);
+
+    if (not was_playing and m_pm_lock)
+        esp_pm_lock_acquire(m_pm_lock);
+
+    // a step running right now rearms the timer by itself and picks the new melody
+    esp_timer_stop(m_timer);
+    esp_timer_start_once(m_timer, 1);
+    return true;
+}
+
+void Buzzer::stop() noexcept
+{
+    if (not m_timer)
+        return;
+
+    portENTER_CRITICAL(&m_lock);
+    bool was_playing = m_melody;
+    m_melody = nullptr;
+    portEXIT_CRITICAL(&m_lock);
+
+    esp_timer_stop(m_timer);
+    tone(0);
+    if (was_playing)
+        finished();
+}
@@ -0,0 +1,120 @@
+#include "esp_log.h"
+#include "nvs.h"
+
+#include "cathodes.h"
+
+static const char *TAG = "CATHODES";
+
+static const char *NVS_NAMESPACE = "dial";
+static const char *NVS_KEY       = "cathodes";
+
+void Cathodes::track(const uint8_t* shown, int64_t now_us) noexcept
+{
+    for (size_t i = 0; i < m_lamps; i++)
+    {
+        // still within a skipped cleaning routine
+        if (now_us < m_since_us[i])
+            continue;
+
+        int64_t elapsed_s = (now_us - m_since_us[i]) / 1000000;
+        if (m_since_us[i] and shown[i] < CATHODES_DIGITS)
+            m_lit_s[i][shown[i]] += elapsed_s;
+
+        // keep the sub-second remainder for the next symbol
+        m_since_us[i] = m_since_us[i] ? m_since_us[i] + elapsed_s * 1000000 : now_us;
+    }
+}
+
+void Cathodes::add(size_t lamp, uint8_t digit, uint32_t seconds) noexcept
+{
+    if (lamp < m_lamps and digit < CATHODES_DIGITS)
+        m_lit_s[lamp][digit] += seconds;
+}
+
+void Cathodes::skip(size_t lamp, int64_t us) noexcept
+{
+    // nothing is accounted before the first track anyway
+    if (lamp < m_lamps and m_since_us[lamp])
+        m_since_us[lamp] += us;
+}
+
+size_t Cathodes::pick(size_t lamp, uint8_t* out, size_t max) const noexcept
+{
+    if (lamp >= m_lamps)
+        return 0;
+
+    const uint32_t* lit = m_lit_s[lamp];
+    uint64_t total = 0;
+    for (uint8_t digit = 0; digit < CATHODES_DIGITS; digit++)
+        total += lit[digit];
+    if (not total)
+        return 0;
+    uint64_t threshold = total / CATHODES_DIGITS / CATHODES_UNDERUSE;
+
+    uint8_t under[CATHODES_DIGITS];
+    size_t  num = 0;
+    for (uint8_t digit = 0; digit < CATHODES_DIGITS; digit++)
+    {
+        if (lit[digit] > threshold)
+            continue;
+
+        size_t pos = num++;
+        for (; pos and lit[under[pos - 1]] > lit[digit]; pos--)
+            under[pos] = under[pos - 1];
+        under[pos] = digit;
+    }
+
+    num = num < max ? num : max;
+    for (size_t i = 0; i < num; i++)
+        out[i] = under[i];
+    return num;
+}
+
+bool Cathodes::due(int hour, int min, bool& night) noexcept
+{
+    night = hour >= CATHODES_NIGHT_FROM and hour < CATHODES_NIGHT_TO;
+    return night or min % CATHODES_DAY_PERIOD == 0;
+}
+
+bool Cathodes::load() noexcept
+{
+    nvs_handle_t handle;
+    if (ESP_OK != nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle))
+        return false;
+
+    size_t size = sizeof(m_lit_s);
+    esp_err_t ret = nvs_get_blob(handle, NVS_KEY, m_lit_s, &size);
+    nvs_close(handle);
+
+    if (ret != ESP_OK or size != sizeof(m_lit_s))
+    {
+        ESP_LOGW(TAG, "No stored cathode usage, starting from zero");
+        for (auto& lamp: m_lit_s)
+            for (auto& lit: lamp)
+                lit = 0;
+        return false;
+    }
+    return true;
+}
+
+bool Cathodes::save() noexcept
+{
+    nvs_handle_t handle;
+    if (ESP_OK != nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle))
+    {
+        ESP_LOGE(TAG, "Could not open NVS");
+        return false;
+    }
+
+    esp_err_t ret = nvs_set_blob(handle, NVS_KEY, m_lit_s, sizeof(m_lit_s));
+    if (ret == ESP_OK)
+        ret = nvs_commit(handle);
+    nvs_close(handle);
+
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Could not store cathode usage");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,204 @@
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "esp_timer.h"
+#include "sdkconfig.h"
+
+#include "chime.h"
+
+static const char *TAG = "CHIME";
+
+bool Chime::dma_adapter(dac_continuous_handle_t, const dac_event_data_t* event, void* ctx)
+{
+    // the driver yields on exit from the interrupt when told a task was woken
+    auto* chime = static_cast<Chime*>(ctx);
+    bool woken = false;
+    if (not chime->m_dma.send_from_isr(event, woken))
+        chime->m_stats.underruns++;
+    return woken;
+}
+
+void Chime::fill(size_t idx, uint32_t rate_hz) noexcept
+{
+    uint32_t start = esp_cpu_get_cycle_count();
+    size_t len = m_decoder.decode(m_buf[idx], CHIME_SAMPLES);
+    uint32_t cycles = esp_cpu_get_cycle_count() - start;
+
+    for (size_t i = len; i < CHIME_SAMPLES; i++)
+        m_buf[idx][i] = WAV_SILENCE;
+    m_len[idx] = len;
+    if (not len)
+        return;
+
+    m_stats.buffers++;
+    m_stats.cycles    += cycles;
+    m_stats.max_cycles = cycles > m_stats.max_cycles ? cycles : m_stats.max_cycles;
+    m_stats.audio_us  += len * 1000000ULL / rate_hz;
+}
+
+uint8_t Chime::stream(uint8_t id) noexcept
+{
+    const wav_info_t& wav = m_chimes[id];
+
+    const dac_continuous_config_t config {
+        .chan_mask = DAC_CHANNEL_MASK_CH0,
+        .desc_num  = CHIME_DMA_DESC,
+        .buf_size  = CHIME_DMA_BUF,
+        .freq_hz   = wav.rate_hz,
+        .offset    = 0,
+        .clk_src   = DAC_DIGI_CLK_SRC_DEFAULT,
+        .chan_mode = DAC_CHANNEL_MODE_SIMUL,
+    };
+    const dac_event_callbacks_t callbacks {
+        .on_convert_done = dma_adapter,
+        .on_stop         = nullptr,
+    };
+    dac_continuous_handle_t dac;
+    if (ESP_OK != dac_continuous_new_channels(&config, &dac))
+    {
+        ESP_LOGE(TAG, "Could not set up DAC for %lu Hz", (unsigned long)wav.rate_hz);
+        return CHIME_STOP;
+    }
+    if (ESP_OK != dac_continuous_register_event_callback(dac, &callbacks, this)
+        or ESP_OK != dac_continuous_enable(dac))
+    {
+        ESP_LOGE(TAG, "Could not enable DAC");
+        dac_continuous_del_channels(dac);
+        return CHIME_STOP;
+    }
+
+    if (m_pm_lock)
+        esp_pm_lock_acquire(m_pm_lock);
+    m_stats.played++;
+    m_decoder.begin(wav);
+    fill(0, wav.rate_hz);
+    fill(1, wav.rate_hz);
+
+    uint8_t cmd  = CHIME_STOP;
+    size_t  cur  = 0;
+    size_t  tail = CHIME_DMA_DESC;  // silent buffers after the end flush the ring
+    dac_continuous_start_async_writing(dac);
+    while (tail)
+    {
+        // a new command cuts the chime short
+        if (m_queue.receive(&cmd, 0))
+            break;
+
+        dac_event_data_t event;
+        if (not m_dma.receive(&event, CHIME_DMA_WAIT_MS))
+        {
+            ESP_LOGE(TAG, "DMA stalled");
+            break;
+        }
+
+        size_t loaded = 0;
+        dac_continuous_write_asynchronously(dac, static_cast<uint8_t*>(event.buf), event.buf_size,
+                                            m_buf[cur], CHIME_SAMPLES, &loaded);
+        if (not m_len[cur])
+            tail--;
+
+        // decode ahead while DMA plays
+        fill(cur, wav.rate_hz);
+        cur = not cur;
+    }
+
+    dac_continuous_stop_async_writing(dac);
+    dac_continuous_disable(dac);
+    dac_continuous_del_channels(dac);
+    if (m_pm_lock)
+        esp_pm_lock_release(m_pm_lock);
+
+    // requests of the deleted channel
+    dac_event_data_t stale;
+    while (m_dma.receive(&stale, 0));
+    return cmd;
+}
+
+void Chime::setup() noexcept
+{
+    const esp_partition_t* part = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                           static_cast<esp_partition_subtype_t>(CHIME_SUBTYPE), CHIME_PARTITION);
+    const void* flash = nullptr;
+    if (not part or ESP_OK != esp_partition_mmap(part, 0, part->size, ESP_PARTITION_MMAP_DATA, &flash, &m_mmap))
+    {
+        ESP_LOGW(TAG, "No chime partition");
+        return;
+    }
+    m_flash = static_cast<const uint8_t*>(flash);
+
+    // files follow each other, an erased word ends the list
+    for (size_t pos = 0; pos < part->size and m_num < CHIME_MAX;)
+    {
+        size_t len = wav_parse(m_flash + pos, part->size - pos, m_chimes[m_num]);
+        if (not len)
+            break;
+        pos += len;
+        m_num++;
+    }
+    ESP_LOGI(TAG, "%u chimes", (unsigned)m_num);
+
+    // DMA stops in light sleep
+    if (ESP_OK != esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "chime", &m_pm_lock))
+        m_pm_lock = nullptr;
+}
+
+void Chime::run() noexcept
+{
+    if (not m_num)
+        return;
+
+    uint8_t cmd;
+    while (1)
+    {
+        if (not m_queue.receive(&cmd, UINT32_MAX))
+            continue;
+
+        // a chime interrupted by another one hands over its command
+        while (cmd != CHIME_STOP)
+        {
+            if (cmd >= m_num)
+            {
+                ESP_LOGW(TAG, "No chime %u", cmd);
+                break;
+            }
+            cmd = stream(cmd);
+        }
+    }
+}
+
+void Chime::teardown() noexcept
+{
+    if (m_flash)
+        esp_partition_munmap(m_mmap);
+    m_flash = nullptr;
+    m_num   = 0;
+
+    if (m_pm_lock)
+    {
+        esp_pm_lock_delete(m_pm_lock);
+        m_pm_lock = nullptr;
+    }
+}
+
+bool Chime::play(uint8_t id) const noexcept
+{
+    return m_queue.send(&id, 0);
+}
+
+bool Chime::stop() const noexcept
+{
+    const uint8_t cmd = CHIME_STOP;
+    return m_queue.send(&cmd, 0);
+}
+
+void Chime::log_stats() const noexcept
+{
+    if (not m_stats.buffers)
+        return;
+
+    // share of a core the decoding takes while a chime plays
+    uint64_t budget = m_stats.audio_us * CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ;
+    ESP_LOGI(TAG, "%lu chimes, %lu buffers, %lu underruns; %lu cycles per buffer, max %lu, %lu.%02lu%% of playback",
+             (unsigned long)m_stats.played, (unsigned long)m_stats.buffers, (unsigned long)m_stats.underruns,
+             (unsigned long)(m_stats.cycles / m_stats.buffers), (unsigned long)m_stats.max_cycles,
+             (unsigned long)(m_stats.cycles * 100 / budget), (unsigned long)(m_stats.cycles * 10000 / budget % 100));
+}
@@ -1,38 +1,193 @@
+#include <cstring>
+
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "dial.h"
 
 static const char *TAG = "DIAL";
 
-bool Lamp::set_value(uint8_t val)
+void Dial::render()
+{
+    frame.ports[GPIOA] = 0;
+    frame.ports[GPIOB] = 0;
+    for (size_t i = 0; i < lamps.size(); i++)
+        frame.ports[lamps[i].port] |= lamps[i].code[frame.values[i]];
+}
+
+void Dial::add_keyframe(const uint8_t* from, const uint8_t* to, uint8_t mix, uint8_t hold)
 {
-    ESP_LOGI(TAG, "Setting lamp value: 0x%u", val);
-    uint8_t reg;
-    if (ESP_OK != mcp23017_read_register(mcp_cfg, MCP23017_GPIO, group, &reg))
+    refresh_lamp_t keyframe[DIAL_MAX_LAMPS];
+    for (size_t i = 0; i < lamps.size(); i++)
     {
-        ESP_LOGE(TAG, "Reading register failed");
-        return false;
+        keyframe[i] = {
+            .port  = lamps[i].port,
+            .lit   = lamps[i].code[to[i]],
+            .from  = lamps[i].code[from[i]],
+            .blank = lamps[i].code[DIAL_BLANK],
+            .level = levels[i],
+            .mix   = mix,
+        };
     }
-    assert(reg);
+    refresh.add({keyframe, lamps.size()}, hold);
+}
 
-    val = reg & address;
-    reg = reg & address;
-    reg = reg | val;
+void Dial::add_cleaning()
+{
+    size_t steps = 0;
+    size_t max = clean_hold == DIAL_CLEAN_NIGHT_HOLD ? REFRESH_MAX_KEYFRAMES - 1 : CATHODES_DAY_STEPS;
 
-    if (ESP_OK != mcp23017_write_register(mcp_cfg, MCP23017_GPIO, group, reg))
+    for (size_t i = 0; i < lamps.size(); i++)
     {
-        ESP_LOGE(TAG, "Writing register failed");
-        return false;
+        clean_num[i] = cathodes.pick(i, clean_picks[i], max < CATHODES_DIGITS ? max : CATHODES_DIGITS);
+        steps = clean_num[i] > steps ? clean_num[i] : steps;
     }
-    return true;
+
+    uint8_t keyframe[DIAL_MAX_LAMPS];
+    for (size_t step = 0; step < steps; step++)
+    {
+        for (size_t i = 0; i < lamps.size(); i++)
+            keyframe[i] = step < clean_num[i] ? clean_picks[i][step] : frame.values[i];
+        add_keyframe(keyframe, keyframe, REFRESH_SLOTS, clean_hold);
+    }
+
+    // credited by the next commit, as far as the refresh timer got
+    clean_credit = steps ? clean_hold : 0;
+    if (steps)
+        ESP_LOGI(TAG, "Cleaning up to %u cathodes per lamp", (unsigned)steps);
+}
+
+void Dial::credit_cleaning()
+{
+    if (not clean_credit)
+        return;
+
+    // the routine leads its program, a later one may have cut it short
+    size_t   played  = refresh.played();
+    int64_t  hold_us = static_cast<int64_t>(clean_credit) * REFRESH_SLOTS * REFRESH_TICK_US;
+    uint32_t hold_s  = static_cast<uint32_t>(hold_us / 1000000);
+    for (size_t i = 0; i < lamps.size(); i++)
+    {
+        size_t num = clean_num[i] < played ? clean_num[i] : played;
+        for (size_t step = 0; step < num; step++)
+            cathodes.add(i, clean_picks[i][step], hold_s);
+        // the routine preceded the shown digit, don't account it twice
+        cathodes.skip(i, num * hold_us);
+    }
+    clean_credit = 0;
+}
+
+bool Dial::commit_program(const uint8_t* prev)
+{
+    refresh.begin();
+
+    if (clean_hold)
+    {
+        // cleaning ends on the new frame, no transition needed
+        add_cleaning();
+        clean_hold = 0;
+    }
+    else if (prev and transition == DIAL_TRANSITION_CROSSFADE)
+    {
+        for (uint8_t step = 1; step < DIAL_FADE_STEPS; step++)
+            add_keyframe(prev, frame.values, step * REFRESH_SLOTS / DIAL_FADE_STEPS, DIAL_FADE_HOLD);
+    }
+    else if (prev and transition == DIAL_TRANSITION_SLOT_MACHINE)
+    {
+        // changed digits roll through all the others and stop on the new one
+        uint8_t roll[DIAL_MAX_LAMPS];
+        for (uint8_t step = 1; step <= DIAL_DIGIT_9; step++)
+        {
+            for (size_t i = 0; i < lamps.size(); i++)
+            {
+                bool rolls = frame.values[i] != prev[i] and frame.values[i] <= DIAL_DIGIT_9;
+                roll[i] = rolls ? (frame.values[i] + step) % (DIAL_DIGIT_9 + 1) : frame.values[i];
+            }
+            add_keyframe(roll, roll, REFRESH_SLOTS, DIAL_ROLL_HOLD);
+        }
+    }
+
+    add_keyframe(frame.values, frame.values, REFRESH_SLOTS, 0);
+    front_valid = false;
+    stats.commits++;
+    return refresh.commit();
 }
 
-Dial::~Dial() noexcept
+bool Dial::commit()
 {
-    for(auto& el: lamps)
+    bus_ops = 0;
+    bool dimmed  = false;
+    bool changed = false;
+    for (size_t i = 0; i < lamps.size(); i++)
+    {
+        dimmed  = dimmed or levels[i] < REFRESH_LEVELS - 1;
+        changed = changed or frame.values[i] != shown[i];
+    }
+    bool animate = changed and shown_valid and transition != DIAL_TRANSITION_NONE;
+
+    credit_cleaning();
+    if (shown_valid)
+        cathodes.track(shown, esp_timer_get_time());
+
+    uint8_t prev[DIAL_MAX_LAMPS];
+    memcpy(prev, shown, sizeof(prev));
+    memcpy(shown, frame.values, sizeof(shown));
+    shown_valid = true;
+
+    // a program still playing takes the frame as its next one, stopping would cut it short
+    if (dimmed or animate or clean_hold or not refresh.finished())
+        return commit_program(animate ? prev : nullptr);
+
+    if (refresh.active())
+        refresh.stop();
+
+    // ports of one frame are adjacent registers, a single run keeps them in one burst
+    uint8_t first = DIAL_PORT_NUM;
+    uint8_t last  = 0;
+    for (uint8_t port = 0; port < DIAL_PORT_NUM; port++)
+    {
+        if (front_valid and front[port] == frame.ports[port])
+        {
+            stats.skipped_writes++;
+            continue;
+        }
+        first = first < port ? first : port;
+        last  = port;
+    }
+    stats.commits++;
+
+    if (first == DIAL_PORT_NUM)
+        return true;
+
+    // an unchanged port in between is rewritten with its own value
+    const expander_txn_t txn {
+        .op    = EXPANDER_WRITE_RUN,
+        .reg   = MCP23017_GPIO,
+        .group = static_cast<mcp23017_gpio_t>(first),
+        .value = 0,
+        .mask  = 0,
+        .cb    = nullptr,
+        .ctx   = nullptr,
+        .data  = &frame.ports[first],
+        .len   = static_cast<uint8_t>(last - first + 1),
+    };
+    stats.port_writes += txn.len;
+    bus_ops++;
+    ESP_LOGD(TAG, "Frame %lu: %lu port writes, %lu skipped", (unsigned long)stats.commits,
+             (unsigned long)stats.port_writes, (unsigned long)stats.skipped_writes);
+
+    mcp23017_err_t err = expander->execute(txn);
+    if (err != MCP23017_ERR_OK)
     {
-        el.~Lamp();
+        ESP_LOGE(TAG, "Writing register failed");
+        front_valid = false;
+        return false;
     }
+
+    for (uint8_t port = 0; port < DIAL_PORT_NUM; port++)
+        front[port] = frame.ports[port];
+    front_valid = true;
+    return true;
 }
 
 bool Dial::set_lamp_value(size_t ind, uint8_t value)
@@ -42,59 +197,123 @@ bool Dial::set_lamp_value(size_t ind, uint8_t value)
         ESP_LOGE("DIAL", "Index out of range");
         return false;
     }
-    bool ret;
-
-    switch (value)
-    {
-        case 0: ret = lamps[ind].set_value(NULY);  break;
-        case 1: ret = lamps[ind].set_value(ONE);   break;
-        case 2: ret = lamps[ind].set_value(TWO);   break;
-        case 3: ret = lamps[ind].set_value(THREE); break;
-        case 4: ret = lamps[ind].set_value(FOUR);  break;
-        case 5: ret = lamps[ind].set_value(FIVE);  break;
-        case 6: ret = lamps[ind].set_value(SIX);   break;
-        case 7: ret = lamps[ind].set_value(SEVEN); break;
-        case 8: ret = lamps[ind].set_value(EIGHT); break;
-        case 9: ret = lamps[ind].set_value(NINE);  break;
-        case UINT8_MAX: ret = lamps[ind ].set_value(DOT); break;
-        default:
-        {
-            ESP_LOGE("DIAL", "Unknown number to set");
-            ret = false;
-        }
+
+    if (value == UINT8_MAX)
+        value = DIAL_DOT;
+    else if (value > DIAL_DIGIT_9)
+    {
+        ESP_LOGE("DIAL", "Unknown number to set");
+        return false;
     }
-    return ret;
+
+    ESP_LOGI(TAG, "Setting lamp value: 0x%u", dial_symbol_codes[value]);
+    frame.values[ind] = value;
+    frame.fields_valid = false;
+    render();
+    return commit();
 }
 
-bool Dial::set_time(tm& timeinfo)
+bool Dial::set_brightness(uint8_t level)
+{
+    if (level >= REFRESH_LEVELS)
+    {
+        ESP_LOGE("DIAL", "Unknown brightness level");
+        return false;
+    }
+
+    for (auto& el: levels)
+        el = level;
+    return commit();
+}
+
+bool Dial::set_lamp_brightness(size_t ind, uint8_t level)
+{
+    if (lamps.size() < ind + 1 or level >= REFRESH_LEVELS)
+    {
+        ESP_LOGE("DIAL", "Index or brightness level out of range");
+        return false;
+    }
+
+    levels[ind] = level;
+    return commit();
+}
+
+void Dial::set_transition(dial_transition_t new_transition) noexcept
+{
+    transition = new_transition;
+}
+
+bool Dial::has_dots() const noexcept
+{
+    for (size_t i = 0; i < layout.num; i++)
+    {
+        if (layout.slots[i].field == DIAL_FIELD_DOT)
+            return true;
+    }
+    return false;
+}
+
+bool Dial::set_dot(bool on)
 {
-    if (lamps.size() < 2)
+    if (dot_on == on or not has_dots())
     {
-        ESP_LOGW("DIAL", "Can`t display time without at least 2 lamps");
+        dot_on = on;
         return true;
     }
 
-    uint8_t ret = 0;
+    dot_on = on;
+    render_time();
+    return commit();
+}
 
-    ret += set_lamp_value(0, timeinfo.tm_hour / 10);
-    ret += set_lamp_value(1, timeinfo.tm_hour % 10);
+bool Dial::set_layout(const dial_layout_t& new_layout) noexcept
+{
+    if (not new_layout.num or new_layout.num > lamps.size())
+    {
+        ESP_LOGE("DIAL", "Layout doesn't fit %u lamps", (unsigned)lamps.size());
+        return false;
+    }
+    layout = new_layout;
+    frame.fields_valid = false;
+    return true;
+}
 
-    if (lamps.size() < 4)
-        return not ret;
+uint8_t Dial::render_time()
+{
+    uint16_t fields[DIAL_FIELD_NUM];
+    dial_fields(time, layout.flags, dot_on, fields);
+    return dial_render(frame, lamps, layout, fields);
+}
 
-    ret += set_lamp_value(2, timeinfo.tm_min / 10);
-    ret += set_lamp_value(3, timeinfo.tm_min % 10);
+dial_update_t Dial::update_time(const tm& timeinfo)
+{
+    time = timeinfo;
+    dial_update_t ret {
+        .changed = render_time(),
+        .bus_ops = 0,
+        .ok      = true,
+    };
 
-    if (lamps.size() < 6)
-        return not ret;
+    bool night;
+    if (timeinfo.tm_min != cleaned_min)
+    {
+        if (Cathodes::due(timeinfo.tm_hour, timeinfo.tm_min, night))
+            clean_hold = night ? DIAL_CLEAN_NIGHT_HOLD : DIAL_CLEAN_DAY_HOLD;
+        if (cleaned_min >= 0 and timeinfo.tm_min == 0)
+            cathodes.save();
+        cleaned_min = timeinfo.tm_min;
+    }
 
-    ret += set_lamp_value(5, timeinfo.tm_sec / 10);
-    ret += set_lamp_value(6, timeinfo.tm_sec % 10);
+    // unchanged digits at full brightness, or a playing program ending on them: nothing to send
+    if (not ret.changed and not clean_hold and ((not refresh.active() and front_valid) or not refresh.finished()))
+        return ret;
 
-    return not ret;
+    ret.ok      = commit();
+    ret.bus_ops = bus_ops;
+    return ret;
 }
 
-void Dial::add_lamp(mcp23017_t *mcp_cfg, uint8_t addr, mcp23017_gpio_t group)
+bool Dial::set_time(tm& timeinfo)
 {
-    lamps.emplace_back(mcp_cfg, addr, group);
+    return update_time(timeinfo).ok;
 }
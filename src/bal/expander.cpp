@@ -0,0 +1,192 @@
+#include "esp_log.h"
+
+#include "expander.h"
+
+static const char *TAG = "EXPANDER";
+
+struct waiter_t {
+    TaskHandle_t   task;
+    mcp23017_err_t err;
+    uint8_t        value;
+};
+
+static void notify_waiter(mcp23017_err_t err, uint8_t value, void* ctx)
+{
+    auto* waiter = static_cast<waiter_t*>(ctx);
+    waiter->err   = err;
+    waiter->value = value;
+    xTaskNotifyGive(waiter->task);
+}
+
+bool Expander::submit(const expander_txn_t& txn, uint32_t timeout_ms) const noexcept
+{
+    return m_queue.send(&txn, timeout_ms);
+}
+
+mcp23017_err_t Expander::execute(const expander_txn_t& txn, uint8_t* value) const noexcept
+{
+    assert(xTaskGetCurrentTaskHandle() != m_handle);
+
+    waiter_t waiter {xTaskGetCurrentTaskHandle(), MCP23017_ERR_FAIL, 0};
+    expander_txn_t sync_txn = txn;
+    sync_txn.cb  = notify_waiter;
+    sync_txn.ctx = &waiter;
+
+    if (not submit(sync_txn, UINT32_MAX))
+        return MCP23017_ERR_FAIL;
+
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    if (value)
+        *value = waiter.value;
+    return waiter.err;
+}
+
+void Expander::setup() noexcept
+{
+    if (MCP23017_ERR_OK != mcp23017_init(&m_mcp))
+    {
+        ESP_LOGE(TAG, "Could not initialise mcp23017!");
+    }
+}
+
+void Expander::run() noexcept
+{
+    while (1)
+    {
+        expander_txn_t txn;
+        if (not m_queue.receive(&txn, UINT32_MAX))
+            continue;
+
+        size_t num = 0;
+        do {
+            process(txn);
+        } while (++num < EXPANDER_QUEUE_LEN and m_queue.receive(&txn, 0));
+
+        flush();
+    }
+}
+
+void Expander::process(const expander_txn_t& txn) noexcept
+{
+    if (txn.op == EXPANDER_DEVICE_READ or txn.op == EXPANDER_DEVICE_WRITE)
+    {
+        // keep submission order: writes queued before land first
+        flush();
+        mcp23017_err_t err = txn.op == EXPANDER_DEVICE_READ
+                ? mcp23017_device_read(&m_mcp, &m_device_health, txn.device, txn.device_reg, txn.buf, txn.len)
+                : mcp23017_device_write(&m_mcp, &m_device_health, txn.device, txn.device_reg, txn.data, txn.len);
+        if (txn.cb)
+            txn.cb(err, 0, txn.ctx);
+        return;
+    }
+
+    uint8_t  addr = mcp23017_register(txn.reg, txn.group);
+    uint32_t bit  = 1UL << addr;
+    assert(addr < EXPANDER_REG_NUM);
+
+    switch (txn.op)
+    {
+        case EXPANDER_WRITE_RUN:
+        {
+            // folded before the next flush, the run can't be split across bursts
+            assert(txn.len and addr + txn.len <= EXPANDER_REG_NUM);
+            for (uint8_t i = 0; i < txn.len; i++)
+                m_pending[addr + i] = txn.data[i];
+            bit = ((1UL << txn.len) - 1) << addr;
+            break;
+        }
+        case EXPANDER_WRITE:
+        {
+            m_pending[addr] = txn.value;
+            break;
+        }
+        case EXPANDER_UPDATE:
+        {
+            if (not (m_pending_dirty & bit))
+            {
+                mcp23017_err_t err = load(addr);
+                if (err != MCP23017_ERR_OK)
+                {
+                    if (txn.cb)
+                        txn.cb(err, 0, txn.ctx);
+                    return;
+                }
+                m_pending[addr] = m_shadow[addr];
+            }
+            m_pending[addr] = (m_pending[addr] & ~txn.mask) | (txn.value & txn.mask);
+            break;
+        }
+        case EXPANDER_DEVICE_READ:
+        case EXPANDER_DEVICE_WRITE:
+            return;
+        case EXPANDER_READ:
+        {
+            // keep submission order: writes queued before the read land first
+            flush();
+            m_shadow_valid &= ~bit;
+            mcp23017_err_t err = load(addr);
+            if (txn.cb)
+                txn.cb(err, m_shadow[addr], txn.ctx);
+            return;
+        }
+    }
+
+    m_pending_dirty |= bit;
+    m_done[m_done_num++] = {txn.cb, txn.ctx, addr};
+}
+
+mcp23017_err_t Expander::load(uint8_t addr) noexcept
+{
+    uint32_t bit = 1UL << addr;
+    if (m_shadow_valid & bit)
+        return MCP23017_ERR_OK;
+
+    auto reg   = static_cast<mcp23017_reg_t>(addr >> 1);
+    auto group = static_cast<mcp23017_gpio_t>(addr & 1);
+    mcp23017_err_t err = mcp23017_read_register(&m_mcp, reg, group, &m_shadow[addr]);
+    if (err == MCP23017_ERR_OK)
+        m_shadow_valid |= bit;
+    return err;
+}
+
+void Expander::flush() noexcept
+{
+    mcp23017_burst_t bursts[EXPANDER_REG_NUM / 2 + 1];
+    size_t           burst_num = 0;
+
+    for (uint8_t addr = 0; addr < EXPANDER_REG_NUM; addr++)
+    {
+        if (not (m_pending_dirty & (1UL << addr)))
+            continue;
+
+        if (burst_num and bursts[burst_num - 1].addr + bursts[burst_num - 1].len == addr)
+            bursts[burst_num - 1].len++;
+        else
+            bursts[burst_num++] = {addr, 1, &m_pending[addr]};
+    }
+
+    mcp23017_err_t err = mcp23017_write_bursts(&m_mcp, bursts, burst_num);
+    if (err == MCP23017_ERR_OK)
+    {
+        for (size_t i = 0; i < burst_num; i++)
+        {
+            for (uint8_t addr = bursts[i].addr; addr < bursts[i].addr + bursts[i].len; addr++)
+                m_shadow[addr] = m_pending[addr];
+        }
+        m_shadow_valid |= m_pending_dirty;
+    }
+    else
+    {
+        // device state unknown, read back before next update
+        m_shadow_valid &= ~m_pending_dirty;
+        mcp23017_log_health(&m_mcp);
+    }
+    m_pending_dirty = 0;
+
+    for (size_t i = 0; i < m_done_num; i++)
+    {
+        if (m_done[i].cb)
+            m_done[i].cb(err, m_pending[m_done[i].addr], m_done[i].ctx);
+    }
+    m_done_num = 0;
+}
@@ -2,6 +2,7 @@
 #define EXPERIMENTS_BOARD_H
 
 #include "osal.h"
+#include "esp_err.h"
 #include "esp_sntp.h"
 
 enum board_event_t {
@@ -21,8 +22,14 @@ enum board_event_t {
     BOARD_LAMP3_SET_VALUE,
     BOARD_LAMP4_SET_VALUE,
 
+    BOARD_DIAL_SET_BRIGHTNESS,
+    BOARD_DIAL_SET_TRANSITION,
+    BOARD_DIAL_SET_DOT,     ///< ignored by layouts without a separator
+    BOARD_DIAL_SET_BLINK,   ///< duty 0..100, ignored by layouts without a separator
+
     BOARD_BUZZER_PLAY,
-    BOARD_BUZZER_STOP,
+    BOARD_BUZZER_STOP,   ///< stops a chime as well
+    BOARD_CHIME_PLAY,
 
     BOARD_EVENT_SIZE
 };
@@ -46,10 +53,13 @@ typedef void(*board_cb_t)();
 /**
  * @brief init board tasks
  *
- * @param [in] rx_init Rx task options
- * @param [in] tx_init Tx task options
+ * @param [in] rx_init  Rx task options
+ * @param [in] tx_init  Tx task options
+ * @param [in] bus_init   expander bus owner task options
+ * @param [in] chime_init sampled chime player task options
  */
-void board_init(const OSAL::Task::init_t& rx_init, const OSAL::Task::init_t& tx_init);
+void board_init(const OSAL::Task::init_t& rx_init, const OSAL::Task::init_t& tx_init,
+                const OSAL::Task::init_t& bus_init, const OSAL::Task::init_t& chime_init);
 
 /**
  * @brief deinit board tasks
@@ -67,6 +77,30 @@ bool board_deinit();
  */
 bool board_register_cb(board_event_t on_event, board_cb_t func);
 
+/**
+ * @brief read registers of another device on the expander's bus
+ *
+ * Blocks until the bus owner task has done the transfer
+ *
+ * @param [in]  device I2C address
+ * @param [in]  reg    first register
+ * @param [out] data   register values
+ * @param [in]  len    number of registers
+ *
+ * @retval ESP_OK                success
+ * @retval ESP_FAIL              not acknowledged, no device
+ * @retval ESP_ERR_TIMEOUT       bus busy or stuck
+ * @retval ESP_ERR_INVALID_STATE board not initialized or device breaker open
+ */
+esp_err_t board_bus_read(uint8_t device, uint8_t reg, uint8_t* data, size_t len);
+
+/**
+ * @brief write registers of another device on the expander's bus
+ *
+ * @copydetails board_bus_read
+ */
+esp_err_t board_bus_write(uint8_t device, uint8_t reg, const uint8_t* data, size_t len);
+
 /**
  * @brief board callback
  *
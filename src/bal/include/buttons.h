@@ -5,6 +5,14 @@
 #include "driver/gpio.h"
 
 
+/**
+ * @class Button
+ * @brief active-low button on a GPIO with a pull-up
+ *
+ * The button is watched with a level interrupt for the level it isn't at, so the same
+ * interrupt wakes the chip from light sleep. The handler is expected to disarm the
+ * interrupt and the owner task to re-arm it once the level has settled.
+ */
 class Button
 {
 private:
@@ -19,6 +27,26 @@ public:
     Button &operator=(const Button &) = default;
     Button &operator=(Button &&) = default;
 
+    /**
+     * @brief install interrupt handler and enable wakeup from light sleep
+     *
+     * @param [in] isr handler, runs in interrupt context
+     * @param [in] arg handler argument
+     *
+     * @retval true  success
+     * @retval false handler couldn't be installed
+     */
+    bool attach(gpio_isr_t isr, void* arg) noexcept;
+
+    /**
+     * @brief wait for the button to change from the given state
+     *
+     * @param [in] pressed state the button is known to be in
+     */
+    void arm(bool pressed) noexcept;
+
+    void disarm() noexcept { gpio_intr_disable(m_port); }  ///< @brief stop interrupts, safe from the handler
+
     bool is_pressed() const;
 };
 
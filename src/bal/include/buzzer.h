@@ -1,4 +1,110 @@
 #ifndef EXPERIMENTS_BUZZER_H
 #define EXPERIMENTS_BUZZER_H
 
+#include <cstdint>
+#include <cstddef>
+
+#include "freertos/FreeRTOS.h"
+#include "driver/ledc.h"
+#include "esp_timer.h"
+#include "esp_pm.h"
+
+#define BUZZER_IO          GPIO_NUM_27
+#define BUZZER_LEDC_MODE   LEDC_LOW_SPEED_MODE
+#define BUZZER_LEDC_TIMER  LEDC_TIMER_1
+#define BUZZER_LEDC_CH     LEDC_CHANNEL_1
+#define BUZZER_DUTY_BITS   LEDC_TIMER_10_BIT
+#define BUZZER_MELODIES    4
+#define BUZZER_MAX_NOTES   48
+#define BUZZER_GAP_MS      15   ///< silence cut from the end of every note, repeated notes stay apart
+#define BUZZER_RING_S      120  ///< looping melody gives up after this
+
+/**
+ * @brief note of a loaded melody
+ */
+struct buzzer_note_t {
+    uint16_t freq_hz;  ///< 0 - pause
+    uint16_t ms;
+};
+
+/**
+ * @class Buzzer
+ * @brief LEDC tone sequencer
+ *
+ * Melodies are parsed from RTTTL once, at load time, into a table of frequencies and durations.
+ * Playback is a one-shot timer that sets the next tone and rearms itself for its duration,
+ * so no task blocks while a melody plays. Light sleep would stop the PWM clock, it is held
+ * off for the time of playback.
+ */
+class Buzzer
+{
+private:
+    struct melody_t {
+        buzzer_note_t notes[BUZZER_MAX_NOTES];
+        uint8_t       len;
+        bool          loop;
+    };
+
+    esp_timer_handle_t   m_timer = nullptr;
+    esp_pm_lock_handle_t m_pm_lock = nullptr;
+    melody_t             m_melodies[BUZZER_MELODIES] = {};
+
+    portMUX_TYPE         m_lock = portMUX_INITIALIZER_UNLOCKED;
+    const melody_t*      m_melody = nullptr;  ///< playing melody
+    uint8_t              m_pos = 0;           ///< next note to play
+    bool                 m_gap = false;       ///< next step silences the note end
+    int64_t              m_until_us = 0;      ///< loop end
+
+    static void step_adapter(void* ctx);
+    void step() noexcept;
+    static void tone(uint16_t freq_hz) noexcept;
+    void finished() noexcept;
+
+public:
+    Buzzer() noexcept = default;
+    ~Buzzer() noexcept;
+
+    Buzzer(const Buzzer&)            = delete;
+    Buzzer(Buzzer&&)                 = delete;
+    Buzzer& operator=(const Buzzer&) = delete;
+    Buzzer& operator=(Buzzer&&)      = delete;
+
+    /**
+     * @brief configure LEDC and the step timer
+     *
+     * @retval true  success
+     * @retval false buzzer won't sound
+     */
+    bool start() noexcept;
+
+    /**
+     * @brief parse RTTTL melody, "name:d=4,o=5,b=120:8c6,8p,4e.6,..."
+     *
+     * @param [in]  rtttl melody
+     * @param [out] out   notes
+     * @param [in]  max   size of @p out
+     *
+     * @return number of notes, 0 - malformed melody
+     */
+    static size_t parse_rtttl(const char* rtttl, buzzer_note_t* out, size_t max) noexcept;
+
+    /**
+     * @brief parse melody into a slot
+     *
+     * @param [in] id    slot
+     * @param [in] rtttl melody
+     * @param [in] loop  repeat until stopped or @ref BUZZER_RING_S passed
+     */
+    bool load(uint8_t id, const char* rtttl, bool loop) noexcept;
+
+    /**
+     * @brief play melody from its start, replaces the playing one
+     *
+     * @param [in] id slot
+     */
+    bool play(uint8_t id) noexcept;
+
+    void stop() noexcept;  ///< @brief silence right away
+};
+
 #endif //EXPERIMENTS_BUZZER_H
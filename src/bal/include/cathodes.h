@@ -0,0 +1,81 @@
+#ifndef EXPERIMENTS_CATHODES_H
+#define EXPERIMENTS_CATHODES_H
+
+#include <cstdint>
+#include <cstddef>
+
+#define CATHODES_MAX_LAMPS   8
+#define CATHODES_DIGITS      10
+#define CATHODES_UNDERUSE    4    ///< cathode is under-used below 1/4 of the lamp average
+#define CATHODES_NIGHT_FROM  2    ///< long routines run from 02:00
+#define CATHODES_NIGHT_TO    5    ///< till 05:00
+#define CATHODES_DAY_PERIOD  15   ///< short routine every 15 minutes during the day
+#define CATHODES_DAY_STEPS   3    ///< digits per lamp exercised by a short routine
+
+/**
+ * @class Cathodes
+ * @brief cathode anti-poisoning bookkeeping
+ *
+ * Tracks how long every digit cathode of every lamp has been lit and picks the
+ * under-used ones for cleaning routines. Counters are kept in NVS across reboots.
+ */
+class Cathodes
+{
+private:
+    uint32_t m_lit_s[CATHODES_MAX_LAMPS][CATHODES_DIGITS] = {};  ///< lit time in seconds
+    int64_t  m_since_us[CATHODES_MAX_LAMPS] = {};                ///< lit time accounted up to
+    size_t   m_lamps;
+
+public:
+    explicit Cathodes(size_t lamps) noexcept : m_lamps{lamps < CATHODES_MAX_LAMPS ? lamps : CATHODES_MAX_LAMPS} {}
+
+    /**
+     * @brief account lit time of the symbols shown until now
+     *
+     * @param [in] shown  symbols shown since the previous call
+     * @param [in] now_us esp_timer time
+     */
+    void track(const uint8_t* shown, int64_t now_us) noexcept;
+
+    /**
+     * @brief account lit time of a cathode exercised by a cleaning routine
+     *
+     * @param [in] lamp    lamp index
+     * @param [in] digit   digit
+     * @param [in] seconds lit time
+     */
+    void add(size_t lamp, uint8_t digit, uint32_t seconds) noexcept;
+
+    /**
+     * @brief leave time out of the next @ref track, the lamp showed a cleaning routine accounted by @ref add
+     *
+     * @param [in] lamp lamp index
+     * @param [in] us   duration of the routine
+     */
+    void skip(size_t lamp, int64_t us) noexcept;
+
+    /**
+     * @brief pick under-used digits of a lamp, least used first
+     *
+     * @param [in]  lamp lamp index
+     * @param [out] out  digits
+     * @param [in]  max  size of @p out
+     *
+     * @return number of digits picked
+     */
+    size_t pick(size_t lamp, uint8_t* out, size_t max) const noexcept;
+
+    /**
+     * @brief check whether a cleaning routine should run at this minute
+     *
+     * @param [in]  hour   local hour
+     * @param [in]  min    local minute
+     * @param [out] night  long night routine
+     */
+    static bool due(int hour, int min, bool& night) noexcept;
+
+    bool load() noexcept;  ///< @brief restore counters from NVS
+    bool save() noexcept;  ///< @brief store counters to NVS
+};
+
+#endif //EXPERIMENTS_CATHODES_H
@@ -0,0 +1,89 @@
+#ifndef EXPERIMENTS_CHIME_H
+#define EXPERIMENTS_CHIME_H
+
+#include <cstdint>
+#include <cstddef>
+
+#include "driver/dac_continuous.h"
+#include "esp_partition.h"
+#include "esp_pm.h"
+
+#include "osal.h"
+#include "wav.h"
+
+#define CHIME_PARTITION    "chimes"   ///< data partition of concatenated WAV files
+#define CHIME_SUBTYPE      0x40
+#define CHIME_MAX          8
+#define CHIME_DMA_DESC     4          ///< DMA buffers in the ring
+#define CHIME_DMA_BUF      1024       ///< bytes of a DMA buffer, the DAC takes a sample per 16 bits
+#define CHIME_SAMPLES      (CHIME_DMA_BUF / 2)
+#define CHIME_DMA_WAIT_MS  500        ///< DMA has to ask for data within this time
+#define CHIME_STOP         UINT8_MAX  ///< command to stop playback
+
+/**
+ * @brief chime playback statistics
+ */
+struct chime_stats_t {
+    uint32_t played;      ///< chimes started
+    uint32_t buffers;     ///< buffers decoded
+    uint32_t underruns;   ///< DMA asked for data faster than the task could load it
+    uint64_t cycles;      ///< CPU cycles spent decoding
+    uint32_t max_cycles;  ///< worst buffer
+    uint64_t audio_us;    ///< playback time decoded
+};
+
+/**
+ * @class Chime
+ * @brief sampled chimes streamed from flash to the DAC
+ *
+ * The chime partition is memory mapped once and WAV files are decoded in place, nothing is copied
+ * to RAM but the buffer being decoded. Two decode buffers are kept: while DMA plays one the other is
+ * decoded ahead, so a DMA request is served by loading a ready buffer. The task doesn't outrank any
+ * board task and shares no bus with the display refresh; DMA keeps the DAC fed in between.
+ */
+class Chime final : public OSAL::Task
+{
+    OSAL::Queue<uint8_t, 2>                       m_queue {nullptr};
+    OSAL::Queue<dac_event_data_t, CHIME_DMA_DESC> m_dma {nullptr};
+
+    esp_partition_mmap_handle_t m_mmap = 0;
+    const uint8_t*              m_flash = nullptr;
+    wav_info_t                  m_chimes[CHIME_MAX] = {};
+    size_t                      m_num = 0;
+    esp_pm_lock_handle_t        m_pm_lock = nullptr;
+
+    WavDecoder    m_decoder;
+    uint8_t       m_buf[2][CHIME_SAMPLES];
+    size_t        m_len[2] = {};  ///< decoded samples, the rest is silence
+    chime_stats_t m_stats = {};
+
+    static bool dma_adapter(dac_continuous_handle_t handle, const dac_event_data_t* event, void* ctx);
+    void    fill(size_t idx, uint32_t rate_hz) noexcept;
+    uint8_t stream(uint8_t id) noexcept;
+
+public:
+    explicit Chime() noexcept : OSAL::Task{} {}
+
+    /**
+     * @brief start chime, replaces the playing one
+     *
+     * @param [in] id chime index in the partition
+     */
+    bool play(uint8_t id) const noexcept;
+    bool stop() const noexcept;  ///< @brief stop playback at the next buffer
+
+    size_t count() const noexcept { return m_num; }
+    const chime_stats_t& get_stats() const noexcept { return m_stats; }
+
+    /**
+     * @brief log decode cost per buffer and its share of the playback time
+     */
+    void log_stats() const noexcept;
+
+private:
+    void setup() noexcept final;
+    void run() noexcept final;
+    void teardown() noexcept final;
+};
+
+#endif //EXPERIMENTS_CHIME_H
@@ -4,65 +4,162 @@
 #include <cstdint>
 #include <cstddef>
 #include <cassert>
-#include <vector>
+#include <array>
+#include <span>
 
 #include "esp_sntp.h"
 
-#include "mcp23017.h"
-
-#define NULY  0x00
-#define ONE   0x11
-#define TWO   0x22
-#define THREE 0x33
-#define FOUR  0x44
-#define FIVE  0x55
-#define SIX   0x66
-#define SEVEN 0x77
-#define EIGHT 0x88
-#define NINE  0x99
-#define DOT   0xAA
-
-class Lamp
-{
-private:
-    uint8_t         value = 0;
-    mcp23017_t*     mcp_cfg;
-    mcp23017_gpio_t group;
-    uint8_t         address;
+#include "layout.h"
+#include "expander.h"
+#include "refresh.h"
+#include "cathodes.h"
 
-public:
-    explicit Lamp(mcp23017_t* mcp_cfg, uint8_t addr, mcp23017_gpio_t group) noexcept :
-        mcp_cfg{mcp_cfg}, address{addr}, group{group} {};
-    ~Lamp() noexcept = default;
+/**
+ * @brief effect played when digits change
+ */
+enum dial_transition_t : uint8_t {
+    DIAL_TRANSITION_NONE,
+    DIAL_TRANSITION_CROSSFADE,     ///< PWM fade from old to new digit
+    DIAL_TRANSITION_SLOT_MACHINE,  ///< changed digits roll through all digits
+
+    DIAL_TRANSITION_NUM
+};
 
-    Lamp(const Lamp &) = default;
-    Lamp(Lamp &&) = default;
-    Lamp &operator=(const Lamp &) = default;
-    Lamp &operator=(Lamp &&) = default;
+#define DIAL_FADE_STEPS 8  ///< crossfade keyframes
+#define DIAL_FADE_HOLD  4  ///< refresh periods per crossfade keyframe (~32 ms)
+#define DIAL_ROLL_HOLD  6  ///< refresh periods per slot machine keyframe (~48 ms)
 
-    bool set_value(uint8_t val);
-    uint8_t get_value() const noexcept { return value; };
+#define DIAL_CLEAN_DAY_HOLD   125  ///< refresh periods per digit of a short cleaning routine (1 s)
+#define DIAL_CLEAN_NIGHT_HOLD 250  ///< refresh periods per digit of a night cleaning routine (2 s)
+
+/**
+ * @brief result of an incremental update
+ */
+struct dial_update_t {
+    uint8_t changed;  ///< bitmask of lamps whose symbol changed
+    uint8_t bus_ops;  ///< port writes issued to the expander (0 when handed to the refresh timer)
+    bool    ok;       ///< frame committed
+};
+
+/**
+ * @brief dial bus traffic statistics
+ */
+struct dial_stats_t {
+    uint32_t commits;        ///< frames committed
+    uint32_t port_writes;    ///< port registers written
+    uint32_t skipped_writes; ///< port registers left untouched because they didn't change
 };
 
 class Dial
 {
 private:
-    std::vector<Lamp> lamps;
+    std::span<const lamp_lut_t> lamps;
+    Expander*                   expander;
+    dial_layout_t               layout;
+    Refresh                     refresh;
+    Cathodes                    cathodes;
+
+    dial_frame_t frame = {};                   ///< frame being rendered
+    uint8_t      levels[DIAL_MAX_LAMPS];       ///< brightness of every lamp
+    uint8_t      shown[DIAL_MAX_LAMPS] = {};   ///< symbols of the last committed frame
+    bool         shown_valid = false;
+    dial_transition_t transition = DIAL_TRANSITION_NONE;
+    tm           time = {};                    ///< time being displayed
+    bool         dot_on = true;                ///< separators lit
+    int          cleaned_min = -1;             ///< minute of the last cleaning check
+    uint8_t      clean_hold = 0;               ///< cleaning routine requested for next commit
+    uint8_t      clean_picks[DIAL_MAX_LAMPS][CATHODES_DIGITS] = {};  ///< digits of the committed routine
+    uint8_t      clean_num[DIAL_MAX_LAMPS] = {};  ///< steps of the committed routine per lamp
+    uint8_t      clean_credit = 0;             ///< hold of the committed routine not credited yet, 0 - none
+    uint8_t      bus_ops = 0;                  ///< port writes of the last commit
+    uint8_t      front[DIAL_PORT_NUM] = {};    ///< frame on the expander
+    bool         front_valid = false;          ///< front buffer matches the expander
+    dial_stats_t stats = {};
+
+    void render();
+    uint8_t render_time();
+    bool commit();
+    bool commit_program(const uint8_t* prev);
+    void add_cleaning();
+    void credit_cleaning();
+    void add_keyframe(const uint8_t* from, const uint8_t* to, uint8_t mix, uint8_t hold);
 
 public:
-    Dial() noexcept = default;
-    ~Dial() noexcept;
+    /**
+     * @brief construct dial
+     *
+     * @param [in] expander bus owner
+     * @param [in] lamps    lamp encoding, usually `dial_desc_t::lut()`
+     * @param [in] layout   time layout, usually `dial_layout()`
+     */
+    explicit Dial(Expander* expander, std::span<const lamp_lut_t> lamps, const dial_layout_t& layout) noexcept :
+        lamps{lamps}, expander{expander}, layout{layout}, refresh{expander}, cathodes{lamps.size()}
+    {
+        assert(lamps.size() <= DIAL_MAX_LAMPS);
+        for (auto& level: levels)
+            level = REFRESH_LEVELS - 1;
+    };
+    ~Dial() noexcept = default;
 
     Dial(const Dial &) = delete;
     Dial(Dial &&) = delete;
     Dial &operator=(const Dial &) = delete;
     Dial &operator=(Dial &&) = delete;
 
-    void add_lamp(mcp23017_t* mcp_cfg, uint8_t addr, mcp23017_gpio_t group);
+    /**
+     * @brief change layout, takes effect on next @ref set_time
+     *
+     * @param [in] new_layout layout
+     *
+     * @retval true  layout applied
+     * @retval false layout is invalid or needs more lamps than the dial has
+     */
+    bool set_layout(const dial_layout_t& new_layout) noexcept;
 
     bool set_time(tm& timeinfo);
+
+    /**
+     * @brief show time, touching only lamps whose digit changed
+     *
+     * @param [in] timeinfo local time
+     *
+     * @return changed lamps and bus operations issued
+     */
+    dial_update_t update_time(const tm& timeinfo);
+
     bool set_lamp_value(size_t ind, uint8_t value);
 
+    /**
+     * @brief light or blank separator lamps of the layout
+     *
+     * @param [in] on separators state
+     */
+    bool set_dot(bool on);
+    bool has_dots() const noexcept;
+
+    /**
+     * @brief set brightness of all lamps
+     *
+     * Below the top level lamps are duty-cycled by the refresh timer
+     *
+     * @param [in] level brightness level, 0 .. REFRESH_LEVELS - 1
+     */
+    bool set_brightness(uint8_t level);
+    bool set_lamp_brightness(size_t ind, uint8_t level);
+
+    /**
+     * @brief select effect for the following digit changes
+     *
+     * @param [in] new_transition effect
+     */
+    void set_transition(dial_transition_t new_transition) noexcept;
+
+    void log_stats() noexcept { refresh.log_stats(); };
+
+    bool restore_usage() noexcept { return cathodes.load(); };  ///< @brief restore cathode usage from NVS
+
+    uint8_t get_lamp_value(size_t ind) const noexcept { return frame.values[ind]; };
+    const dial_stats_t& get_stats() const noexcept { return stats; };
 };
 
 #endif //EXPERIMENTS_DIAL_H
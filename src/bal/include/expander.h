@@ -0,0 +1,112 @@
+#ifndef EXPERIMENTS_EXPANDER_H
+#define EXPERIMENTS_EXPANDER_H
+
+#include <cstdint>
+#include <cstddef>
+
+#include "osal.h"
+#include "mcp23017.h"
+
+#define EXPANDER_QUEUE_LEN 16
+#define EXPANDER_REG_NUM   0x16
+
+enum expander_op_t {
+    EXPANDER_WRITE,   ///< write value to register
+    EXPANDER_UPDATE,  ///< replace masked bits of register with value
+    EXPANDER_READ,    ///< read register
+    EXPANDER_WRITE_RUN,  ///< write consecutive registers, all land in the same burst
+    EXPANDER_DEVICE_READ,   ///< read registers of another device on the bus
+    EXPANDER_DEVICE_WRITE,  ///< write registers of another device on the bus
+};
+
+/**
+ * @brief transaction completion function
+ *
+ * Called from the bus owner task, keep it short
+ *
+ * @param [in]     err   transaction result
+ * @param [in]     value register value after the transaction
+ * @param [in,out] ctx   user context
+ */
+typedef void(*expander_done_cb_t)(mcp23017_err_t err, uint8_t value, void* ctx);
+
+struct expander_txn_t {
+    expander_op_t      op;
+    mcp23017_reg_t     reg;
+    mcp23017_gpio_t    group;
+    uint8_t            value;
+    uint8_t            mask;   ///< bits of value to apply (@ref EXPANDER_UPDATE only)
+    expander_done_cb_t cb;     ///< completion function (nullptr - fire and forget)
+    void*              ctx;    ///< completion function context
+    const uint8_t*     data;   ///< values from the first register on (@ref EXPANDER_WRITE_RUN, EXPANDER_DEVICE_WRITE), valid till completion
+    uint8_t            len;    ///< number of registers
+    uint8_t            device;      ///< I2C address of the other device (device operations only)
+    uint8_t            device_reg;  ///< its first register
+    uint8_t*           buf;         ///< values read (@ref EXPANDER_DEVICE_READ), valid till completion
+};
+
+/**
+ * @class Expander
+ * @brief MCP23017 bus owner
+ *
+ * The only task that talks to the expander and its bus. Other tasks submit transactions to its queue.
+ * Every wakeup drains the queue, folds writes into a register image and flushes
+ * runs of adjacent registers in one I2C session. Other devices of the bus are reached through
+ * device transactions, so bus recovery never runs under a transfer of another task.
+ */
+class Expander final : public OSAL::Task
+{
+private:
+    OSAL::Queue<expander_txn_t, EXPANDER_QUEUE_LEN> m_queue {nullptr};
+
+    mcp23017_t m_mcp;
+    uint8_t    m_shadow[EXPANDER_REG_NUM] = {};  ///< last known register values
+    uint32_t   m_shadow_valid = 0;               ///< bitmask of known registers
+    uint8_t    m_pending[EXPANDER_REG_NUM] = {}; ///< values waiting for flush
+    uint32_t   m_pending_dirty = 0;              ///< bitmask of registers waiting for flush
+    mcp23017_health_t m_device_health = {};      ///< other devices of the bus
+
+    struct done_t {
+        expander_done_cb_t cb;
+        void*              ctx;
+        uint8_t            addr;
+    };
+    done_t m_done[EXPANDER_QUEUE_LEN];
+    size_t m_done_num = 0;
+
+public:
+    explicit Expander(const mcp23017_t& mcp) noexcept : OSAL::Task{}, m_mcp{mcp} {}
+
+    /**
+     * @brief submit transaction without waiting
+     *
+     * @param [in] txn        transaction
+     * @param [in] timeout_ms timeout in ms for queue space
+     *
+     * @retval true  transaction queued
+     * @retval false queue full
+     */
+    [[nodiscard]] bool submit(const expander_txn_t& txn, uint32_t timeout_ms) const noexcept;
+
+    /**
+     * @brief submit transaction and wait for its completion
+     *
+     * @param [in]  txn   transaction (completion function is ignored)
+     * @param [out] value register value after the transaction (may be nullptr)
+     *
+     * @return transaction result
+     */
+    mcp23017_err_t execute(const expander_txn_t& txn, uint8_t* value = nullptr) const noexcept;
+
+    void log_health() const noexcept { mcp23017_log_health(&m_mcp); }
+
+private:
+    void setup() noexcept final;
+    void run() noexcept final;
+
+    void process(const expander_txn_t& txn) noexcept;
+    mcp23017_err_t load(uint8_t addr) noexcept;
+    void flush() noexcept;
+};
+
+#endif //EXPERIMENTS_EXPANDER_H
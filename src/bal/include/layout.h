@@ -0,0 +1,241 @@
+#ifndef EXPERIMENTS_LAYOUT_H
+#define EXPERIMENTS_LAYOUT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <ctime>
+#include <array>
+#include <span>
+
+#define NULY  0x00
+#define ONE   0x11
+#define TWO   0x22
+#define THREE 0x33
+#define FOUR  0x44
+#define FIVE  0x55
+#define SIX   0x66
+#define SEVEN 0x77
+#define EIGHT 0x88
+#define NINE  0x99
+#define DOT   0xAA
+#define BLANK 0xFF  ///< multiplexer output not wired to any cathode
+
+#define DIAL_PORT_NUM  2  ///< GPIOA and GPIOB
+#define DIAL_MAX_LAMPS 8  ///< two lamps per port nibble pair
+
+/**
+ * @brief symbols a lamp can show
+ */
+enum dial_symbol_t : uint8_t {
+    DIAL_DIGIT_0,
+    DIAL_DIGIT_9 = 9,
+    DIAL_DOT,
+    DIAL_BLANK,
+
+    DIAL_SYMBOL_NUM
+};
+
+/**
+ * @brief multiplexer code of every symbol, both nibbles
+ */
+inline constexpr std::array<uint8_t, DIAL_SYMBOL_NUM> dial_symbol_codes {
+    NULY, ONE, TWO, THREE, FOUR, FIVE, SIX, SEVEN, EIGHT, NINE, DOT, BLANK,
+};
+
+/**
+ * @brief where a lamp is wired on the expander
+ */
+struct lamp_desc_t {
+    uint8_t port;  ///< expander port, GPIOA - 0, GPIOB - 1
+    uint8_t mask;  ///< port bits driving the lamp
+};
+
+/**
+ * @brief lamp encoding generated from @ref lamp_desc_t
+ */
+struct lamp_lut_t {
+    uint8_t port;                    ///< expander port
+    uint8_t mask;                    ///< port bits driving the lamp
+    uint8_t code[DIAL_SYMBOL_NUM];   ///< symbol codes already masked to the lamp bits
+};
+
+/**
+ * @brief compile time board description
+ *
+ * @tparam N number of lamps
+ */
+template<size_t N>
+struct dial_desc_t {
+    static_assert(N > 0 and N <= DIAL_MAX_LAMPS, "Unsupported number of lamps");
+
+    std::array<lamp_desc_t, N> lamps;
+
+    /**
+     * @brief check that lamps don't share port bits
+     */
+    [[nodiscard]] constexpr bool valid() const noexcept
+    {
+        uint8_t used[DIAL_PORT_NUM] = {};
+        for (const auto& lamp: lamps)
+        {
+            if (lamp.port >= DIAL_PORT_NUM or not lamp.mask or (used[lamp.port] & lamp.mask))
+                return false;
+            used[lamp.port] |= lamp.mask;
+        }
+        return true;
+    }
+
+    /**
+     * @brief generate symbol encoding of every lamp
+     */
+    [[nodiscard]] constexpr std::array<lamp_lut_t, N> lut() const noexcept
+    {
+        std::array<lamp_lut_t, N> ret {};
+        for (size_t i = 0; i < N; i++)
+        {
+            ret[i].port = lamps[i].port;
+            ret[i].mask = lamps[i].mask;
+            for (size_t sym = 0; sym < DIAL_SYMBOL_NUM; sym++)
+                ret[i].code[sym] = dial_symbol_codes[sym] & lamps[i].mask;
+        }
+        return ret;
+    }
+};
+
+/**
+ * @brief values a layout slot can take its digit from
+ */
+enum dial_field_t : uint8_t {
+    DIAL_FIELD_HOUR,
+    DIAL_FIELD_MIN,
+    DIAL_FIELD_SEC,
+    DIAL_FIELD_DAY,
+    DIAL_FIELD_MONTH,
+    DIAL_FIELD_YEAR,
+    DIAL_FIELD_DOT,    ///< separator, holds a symbol
+    DIAL_FIELD_BLANK,  ///< unused lamp, holds a symbol
+
+    DIAL_FIELD_NUM
+};
+
+#define DIAL_LAYOUT_12H        0x01  ///< 12 hour clock
+#define DIAL_LAYOUT_BLANK_ZERO 0x02  ///< blank leading zero of the first field
+
+/**
+ * @brief one lamp of a layout
+ */
+struct dial_slot_t {
+    uint8_t  field;       ///< @ref dial_field_t
+    uint16_t div;         ///< digit divisor, 0 - field value is the symbol itself
+    bool     blank_zero;  ///< show zero digit as blank
+};
+
+/**
+ * @brief precomputed mapping from time fields to lamps
+ */
+struct dial_layout_t {
+    dial_slot_t slots[DIAL_MAX_LAMPS];
+    uint8_t     num;    ///< number of slots, 0 - invalid format
+    uint8_t     flags;  ///< DIAL_LAYOUT_* flags
+};
+
+/**
+ * @brief build layout from format string
+ *
+ * One character per lamp: `H` hour, `M` minute, `S` second, `d` day, `m` month, `y` year,
+ * `.` or `:` separator, ` ` blank. A run of the same letter takes that many digits of the field,
+ * e.g. "HHMMSS", "dd.mm", "yyyy".
+ *
+ * @param [in] fmt   format string
+ * @param [in] flags DIAL_LAYOUT_* flags
+ *
+ * @return layout, `num` is 0 if format is invalid
+ */
+constexpr dial_layout_t dial_layout(const char* fmt, uint8_t flags = 0) noexcept
+{
+    dial_layout_t ret {};
+    ret.flags = flags;
+    bool leading = flags & DIAL_LAYOUT_BLANK_ZERO;
+
+    size_t i = 0;
+    while (fmt[i])
+    {
+        uint8_t field;
+        switch (fmt[i])
+        {
+            case 'H': field = DIAL_FIELD_HOUR;  break;
+            case 'M': field = DIAL_FIELD_MIN;   break;
+            case 'S': field = DIAL_FIELD_SEC;   break;
+            case 'd': field = DIAL_FIELD_DAY;   break;
+            case 'm': field = DIAL_FIELD_MONTH; break;
+            case 'y': field = DIAL_FIELD_YEAR;  break;
+            case '.':
+            case ':': field = DIAL_FIELD_DOT;   break;
+            case ' ': field = DIAL_FIELD_BLANK; break;
+            default:  return {};
+        }
+
+        size_t run = 1;
+        if (field < DIAL_FIELD_DOT)
+        {
+            while (fmt[i + run] == fmt[i])
+                run++;
+        }
+        if (ret.num + run > DIAL_MAX_LAMPS or run > 4)
+            return {};
+
+        uint16_t div = 1;
+        for (size_t k = 1; k < run; k++)
+            div *= 10;
+
+        for (size_t k = 0; k < run; k++)
+        {
+            bool is_digit = field < DIAL_FIELD_DOT;
+            ret.slots[ret.num++] = {
+                .field      = field,
+                .div        = static_cast<uint16_t>(is_digit ? div : 0),
+                .blank_zero = is_digit and leading and k == 0 and run > 1,
+            };
+            div /= 10;
+        }
+        if (field < DIAL_FIELD_DOT)
+            leading = false;
+        i += run;
+    }
+    return ret;
+}
+
+/**
+ * @brief rendered dial state
+ */
+struct dial_frame_t {
+    uint8_t  values[DIAL_MAX_LAMPS];  ///< symbol of every lamp
+    uint8_t  ports[DIAL_PORT_NUM];    ///< port register values
+    uint16_t fields[DIAL_FIELD_NUM];  ///< field values the frame was rendered from
+    bool     fields_valid;            ///< false - render every slot
+};
+
+/**
+ * @brief fill field values of a layout from time
+ *
+ * @param [in]  time   local time
+ * @param [in]  flags  DIAL_LAYOUT_* flags
+ * @param [in]  dot_on separators lit
+ * @param [out] fields field values
+ */
+void dial_fields(const tm& time, uint8_t flags, bool dot_on, uint16_t (&fields)[DIAL_FIELD_NUM]) noexcept;
+
+/**
+ * @brief render only the lamps whose field changed since the previous frame
+ *
+ * @param [in,out] frame  frame to update
+ * @param [in]     lamps  lamp encoding
+ * @param [in]     layout layout
+ * @param [in]     fields new field values
+ *
+ * @return bitmask of lamps whose symbol changed
+ */
+uint8_t dial_render(dial_frame_t& frame, std::span<const lamp_lut_t> lamps, const dial_layout_t& layout,
+                    const uint16_t (&fields)[DIAL_FIELD_NUM]) noexcept;
+
+#endif //EXPERIMENTS_LAYOUT_H
@@ -0,0 +1,23 @@
+#ifndef EXPERIMENTS_NIXIE_H
+#define EXPERIMENTS_NIXIE_H
+
+#include "layout.h"
+
+/**
+ * @brief lamps of the board from left to right, port 0 - GPIOA, 1 - GPIOB
+ */
+inline constexpr dial_desc_t<4> nixie_desc {{{
+        {0, 0xF0},
+        {1, 0x0F},
+        {1, 0xF0},
+        {0, 0x0F},
+}}};
+static_assert(nixie_desc.valid(), "Lamps share expander pins");
+
+/**
+ * @brief time layout shown on the board
+ */
+inline constexpr dial_layout_t nixie_layout = dial_layout("HHMM");
+static_assert(nixie_layout.num and nixie_layout.num <= nixie_desc.lamps.size(), "Layout doesn't fit the dial");
+
+#endif //EXPERIMENTS_NIXIE_H
@@ -0,0 +1,170 @@
+#ifndef EXPERIMENTS_REFRESH_H
+#define EXPERIMENTS_REFRESH_H
+
+#include <cstdint>
+#include <cstddef>
+#include <span>
+
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+#include "expander.h"
+
+#define REFRESH_TICK_US       500  ///< 2 kHz refresh timer
+#define REFRESH_SLOTS         16   ///< ticks per PWM period (125 Hz)
+#define REFRESH_LEVELS        8    ///< brightness levels, 0 - off
+#define REFRESH_PORT_NUM      2    ///< GPIOA and GPIOB
+#define REFRESH_MAX_KEYFRAMES 12   ///< keyframes of one program
+
+/**
+ * @brief lit slots per PWM period of every level, round(16 * (level / 7) ^ 2.2)
+ */
+inline constexpr uint8_t refresh_gamma[REFRESH_LEVELS] = {0, 1, 2, 3, 5, 8, 11, 16};
+static_assert(refresh_gamma[REFRESH_LEVELS - 1] == REFRESH_SLOTS);
+
+/**
+ * @brief lamp as seen by the refresh engine
+ *
+ * The lamp is lit for `refresh_gamma[level]` slots of a period. Of those, the first
+ * `mix / REFRESH_SLOTS` part shows @ref lit and the rest shows @ref from.
+ */
+struct refresh_lamp_t {
+    uint8_t port;   ///< expander port
+    uint8_t lit;    ///< port bits with the lamp showing its symbol
+    uint8_t from;   ///< port bits with the lamp showing the symbol it fades from
+    uint8_t blank;  ///< port bits with the lamp blanked
+    uint8_t level;  ///< brightness level
+    uint8_t mix;    ///< share of @ref lit in lit slots, 0 .. REFRESH_SLOTS
+};
+
+/**
+ * @brief refresh engine statistics
+ */
+struct refresh_stats_t {
+    uint32_t ticks;       ///< timer ticks
+    uint32_t writes;      ///< port writes submitted
+    uint32_t dropped;     ///< port writes postponed because the bus queue was full
+    uint32_t programs;    ///< programs loaded
+    uint64_t cycles;      ///< CPU cycles spent in the timer callback
+};
+
+/**
+ * @class Refresh
+ * @brief timer driven software PWM and keyframe playback of the lamps
+ *
+ * Every PWM period is split in @ref REFRESH_SLOTS ticks. A program is a table of keyframes,
+ * each one holding the port values of every slot for a number of periods; the last keyframe
+ * holds until the next program. Keyframes are computed once by @ref add, the timer only writes
+ * ports that differ from the previous tick. A new program replaces the playing one at the next
+ * period, so the latest frame is never delayed by a transition.
+ */
+class Refresh
+{
+private:
+    using schedule_t = uint8_t[REFRESH_SLOTS][REFRESH_PORT_NUM];
+
+    struct program_t {
+        schedule_t frames[REFRESH_MAX_KEYFRAMES];
+        uint8_t    hold[REFRESH_MAX_KEYFRAMES];  ///< periods to show a keyframe
+        uint8_t    len;
+    };
+
+    Expander*          m_expander;
+    esp_timer_handle_t m_timer = nullptr;
+
+    program_t       m_programs[2] = {};  ///< playing and staged program
+    uint8_t         m_playing = 0;
+    bool            m_pending = false;   ///< staged program waits for period start
+    portMUX_TYPE    m_lock = portMUX_INITIALIZER_UNLOCKED;
+
+    uint8_t         m_pos = 0;           ///< keyframe being played
+    uint8_t         m_hold_left = 0;
+    uint8_t         m_slot = 0;
+    uint8_t         m_last[REFRESH_PORT_NUM] = {};  ///< port values last submitted
+    uint8_t         m_last_valid = 0;  ///< bit per port, set once its m_last was written
+    refresh_stats_t m_stats = {};
+    refresh_stats_t m_reported = {};
+    int64_t         m_reported_us = 0;
+
+    static void tick_adapter(void* ctx);
+    void tick() noexcept;
+    bool settled() const noexcept;
+
+public:
+    explicit Refresh(Expander* expander) noexcept : m_expander{expander} {}
+    ~Refresh() noexcept;
+
+    Refresh(const Refresh&)            = delete;
+    Refresh(Refresh&&)                 = delete;
+    Refresh& operator=(const Refresh&) = delete;
+    Refresh& operator=(Refresh&&)      = delete;
+
+    /**
+     * @brief start refresh timer
+     *
+     * @retval true  success
+     * @retval false timer couldn't be created
+     */
+    bool start() noexcept;
+
+    /**
+     * @brief stop refresh timer, ports keep the last written values
+     */
+    void stop() noexcept;
+
+    /**
+     * @brief check whether the refresh timer runs
+     *
+     * Dimmed lamps keep it running for PWM, its 2 kHz wakeups block light sleep meanwhile
+     */
+    bool active() const noexcept { return m_timer and esp_timer_is_active(m_timer); }
+
+    /**
+     * @brief check that the playing program reached its last keyframe and no other one waits
+     *
+     * The timer may still run for PWM, stopping it doesn't cut a program short then
+     */
+    bool finished() noexcept;
+
+    /**
+     * @brief count keyframes of the last committed program already played through
+     *
+     * @return 0 while it waits for its period, one less than its length once on the last keyframe
+     */
+    uint8_t played() noexcept;
+
+    /**
+     * @brief start building a new program
+     *
+     * The playing program keeps running until @ref commit
+     */
+    void begin() noexcept;
+
+    /**
+     * @brief append keyframe to the program being built
+     *
+     * @param [in] lamps every lamp of the keyframe
+     * @param [in] hold  periods to show the keyframe
+     *
+     * @retval true  keyframe added
+     * @retval false program is full
+     */
+    bool add(std::span<const refresh_lamp_t> lamps, uint8_t hold) noexcept;
+
+    /**
+     * @brief play the built program from the next period
+     *
+     * The last keyframe holds until the next program. The timer stops by itself
+     * once that keyframe is written and doesn't need PWM.
+     */
+    bool commit() noexcept;
+
+    /**
+     * @brief log CPU and bus cost per second since the previous call
+     */
+    void log_stats() noexcept;
+
+    const refresh_stats_t& get_stats() const noexcept { return m_stats; }
+};
+
+#endif //EXPERIMENTS_REFRESH_H
@@ -0,0 +1,73 @@
+#ifndef EXPERIMENTS_WAV_H
+#define EXPERIMENTS_WAV_H
+
+#include <cstdint>
+#include <cstddef>
+
+#define WAV_FORMAT_PCM       1
+#define WAV_FORMAT_IMA_ADPCM 0x11
+#define WAV_SILENCE          128   ///< DAC code of the zero sample
+
+/**
+ * @brief mono WAV file, samples stay where the file is
+ */
+struct wav_info_t {
+    const uint8_t* data;         ///< sample data
+    size_t         size;         ///< bytes of sample data
+    uint32_t       rate_hz;
+    uint16_t       format;       ///< WAV_FORMAT_PCM or WAV_FORMAT_IMA_ADPCM
+    uint16_t       bits;         ///< 8, 16 - PCM, 4 - ADPCM
+    uint16_t       block_align;  ///< ADPCM block, header included
+};
+
+/**
+ * @brief parse RIFF WAV header
+ *
+ * Only mono 8/16 bit PCM and 4 bit IMA ADPCM are accepted
+ *
+ * @param [in]  file file start
+ * @param [in]  size bytes available from @p file
+ * @param [out] out  sample format and data
+ *
+ * @return bytes the whole file takes, even padded; 0 - not a supported WAV
+ */
+size_t wav_parse(const uint8_t* file, size_t size, wav_info_t& out) noexcept;
+
+/**
+ * @class WavDecoder
+ * @brief incremental decoder to 8 bit unsigned samples of the DAC
+ *
+ * Reads samples in place, so a file in memory mapped flash is never copied to RAM.
+ * Decoding resumes mid ADPCM block, any output size works.
+ */
+class WavDecoder
+{
+private:
+    wav_info_t m_wav = {};
+    size_t     m_pos = 0;         ///< next byte of sample data
+    size_t     m_block_left = 0;  ///< ADPCM bytes left in the block
+    int32_t    m_predictor = 0;
+    int8_t     m_index = 0;
+    uint8_t    m_byte = 0;
+    bool       m_high = false;    ///< high nibble of @ref m_byte is next
+
+    size_t decode_adpcm(uint8_t* out, size_t max) noexcept;
+
+public:
+    /**
+     * @brief start decoding a file from its first sample
+     */
+    void begin(const wav_info_t& wav) noexcept;
+
+    /**
+     * @brief decode next samples
+     *
+     * @param [out] out samples
+     * @param [in]  max size of @p out
+     *
+     * @return samples decoded, less than @p max at the end of data
+     */
+    size_t decode(uint8_t* out, size_t max) noexcept;
+};
+
+#endif //EXPERIMENTS_WAV_H
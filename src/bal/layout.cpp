@@ -0,0 +1,65 @@
+#include <cstring>
+
+#include "layout.h"
+
+void dial_fields(const tm& time, uint8_t flags, bool dot_on, uint16_t (&fields)[DIAL_FIELD_NUM]) noexcept
+{
+    int hour = time.tm_hour;
+    if (flags & DIAL_LAYOUT_12H)
+        hour = hour % 12 ? hour % 12 : 12;
+
+    fields[DIAL_FIELD_HOUR]  = static_cast<uint16_t>(hour);
+    fields[DIAL_FIELD_MIN]   = static_cast<uint16_t>(time.tm_min);
+    fields[DIAL_FIELD_SEC]   = static_cast<uint16_t>(time.tm_sec);
+    fields[DIAL_FIELD_DAY]   = static_cast<uint16_t>(time.tm_mday);
+    fields[DIAL_FIELD_MONTH] = static_cast<uint16_t>(time.tm_mon + 1);
+    fields[DIAL_FIELD_YEAR]  = static_cast<uint16_t>(time.tm_year + 1900);
+    fields[DIAL_FIELD_DOT]   = static_cast<uint16_t>(dot_on ? DIAL_DOT : DIAL_BLANK);
+    fields[DIAL_FIELD_BLANK] = DIAL_BLANK;
+}
+
+uint8_t dial_render(dial_frame_t& frame, std::span<const lamp_lut_t> lamps, const dial_layout_t& layout,
+                    const uint16_t (&fields)[DIAL_FIELD_NUM]) noexcept
+{
+    uint16_t dirty = 0;
+    for (uint8_t field = 0; field < DIAL_FIELD_NUM; field++)
+    {
+        if (not frame.fields_valid or frame.fields[field] != fields[field])
+            dirty |= 1 << field;
+        frame.fields[field] = fields[field];
+    }
+
+    if (not frame.fields_valid)
+    {
+        memset(frame.ports, 0, sizeof(frame.ports));
+        for (size_t i = 0; i < lamps.size(); i++)
+            frame.ports[lamps[i].port] |= lamps[i].code[frame.values[i]];
+    }
+    frame.fields_valid = true;
+
+    // a minute tick dirties one or two fields, every other lamp is skipped
+    uint8_t changed = 0;
+    for (size_t i = 0; i < lamps.size(); i++)
+    {
+        uint8_t field = i < layout.num ? static_cast<uint8_t>(layout.slots[i].field) : static_cast<uint8_t>(DIAL_FIELD_BLANK);
+        if (not (dirty & (1 << field)))
+            continue;
+
+        uint8_t sym = static_cast<uint8_t>(DIAL_BLANK);
+        if (i < layout.num)
+        {
+            const dial_slot_t& slot = layout.slots[i];
+            sym = slot.div ? (fields[field] / slot.div) % 10 : fields[field];
+            if (slot.blank_zero and not sym)
+                sym = DIAL_BLANK;
+        }
+        if (sym == frame.values[i])
+            continue;
+
+        const lamp_lut_t& lamp = lamps[i];
+        frame.values[i] = sym;
+        frame.ports[lamp.port] = (frame.ports[lamp.port] & ~lamp.mask) | lamp.code[sym];
+        changed |= 1 << i;
+    }
+    return changed;
+}
@@ -0,0 +1,222 @@
+#include <cstring>
+
+#include "esp_log.h"
+#include "esp_cpu.h"
+
+#include "refresh.h"
+
+static const char *TAG = "REFRESH";
+
+void Refresh::tick_adapter(void* ctx)
+{
+    static_cast<Refresh*>(ctx)->tick();
+}
+
+bool Refresh::settled() const noexcept
+{
+    const program_t& program = m_programs[m_playing];
+    if (m_pos + 1 < program.len)
+        return false;
+
+    // last keyframe without PWM: nothing left to do once it is written
+    const schedule_t& frame = program.frames[m_pos];
+    for (uint8_t slot = 1; slot < REFRESH_SLOTS; slot++)
+    {
+        if (memcmp(frame[slot], frame[0], REFRESH_PORT_NUM))
+            return false;
+    }
+    return m_last_valid == (1 << REFRESH_PORT_NUM) - 1 and not memcmp(m_last, frame[0], REFRESH_PORT_NUM);
+}
+
+void Refresh::tick() noexcept
+{
+    uint32_t start = esp_cpu_get_cycle_count();
+    m_stats.ticks++;
+
+    if (m_slot == 0)
+    {
+        portENTER_CRITICAL(&m_lock);
+        if (m_pending)
+        {
+            m_playing   = not m_playing;
+            m_pending   = false;
+            m_pos       = 0;
+            m_hold_left = m_programs[m_playing].hold[0];
+        }
+        else if (m_hold_left and not --m_hold_left)
+        {
+            m_pos++;
+            m_hold_left = m_programs[m_playing].hold[m_pos];
+        }
+        portEXIT_CRITICAL(&m_lock);
+    }
+
+    const uint8_t* ports = m_programs[m_playing].frames[m_pos][m_slot];
+    for (uint8_t port = 0; port < REFRESH_PORT_NUM; port++)
+    {
+        uint8_t bit = 1 << port;
+        if ((m_last_valid & bit) and m_last[port] == ports[port])
+            continue;
+
+        expander_txn_t txn {
+            .op    = EXPANDER_WRITE,
+            .reg   = MCP23017_GPIO,
+            .group = static_cast<mcp23017_gpio_t>(port),
+            .value = ports[port],
+        };
+
+        // never block the timer, a postponed write is retried on the next tick
+        if (not m_expander->submit(txn, 0))
+        {
+            m_stats.dropped++;
+            continue;
+        }
+        m_last[port] = ports[port];
+        m_last_valid |= bit;
+        m_stats.writes++;
+    }
+
+    m_slot = (m_slot + 1) % REFRESH_SLOTS;
+
+    // checked and stopped under the lock, a program committed meanwhile finds the timer stopped and restarts it
+    if (m_slot == 0)
+    {
+        portENTER_CRITICAL(&m_lock);
+        if (not m_pending and settled())
+            esp_timer_stop(m_timer);
+        portEXIT_CRITICAL(&m_lock);
+    }
+
+    m_stats.cycles += esp_cpu_get_cycle_count() - start;
+}
+
+Refresh::~Refresh() noexcept
+{
+    if (not m_timer)
+        return;
+
+    stop();
+    esp_timer_delete(m_timer);
+}
+
+bool Refresh::start() noexcept
+{
+    if (not m_timer)
+    {
+        const esp_timer_create_args_t args {
+            .callback              = tick_adapter,
+            .arg                   = this,
+            .dispatch_method       = ESP_TIMER_TASK,
+            .name                  = "refresh",
+            .skip_unhandled_events = true,
+        };
+        if (ESP_OK != esp_timer_create(&args, &m_timer))
+        {
+            ESP_LOGE(TAG, "Could not create refresh timer");
+            m_timer = nullptr;
+            return false;
+        }
+    }
+
+    if (esp_timer_is_active(m_timer))
+        return true;
+
+    m_slot       = 0;
+    m_last_valid = 0;
+    return ESP_OK == esp_timer_start_periodic(m_timer, REFRESH_TICK_US);
+}
+
+void Refresh::stop() noexcept
+{
+    if (m_timer and esp_timer_is_active(m_timer))
+        esp_timer_stop(m_timer);
+}
+
+bool Refresh::finished() noexcept
+{
+    // nothing plays without the timer, not even a program it failed to start for
+    if (not active())
+        return true;
+
+    portENTER_CRITICAL(&m_lock);
+    bool ret = not m_pending and m_pos + 1 >= m_programs[m_playing].len;
+    portEXIT_CRITICAL(&m_lock);
+    return ret;
+}
+
+uint8_t Refresh::played() noexcept
+{
+    portENTER_CRITICAL(&m_lock);
+    uint8_t ret = m_pending ? 0 : m_pos;
+    portEXIT_CRITICAL(&m_lock);
+    return ret;
+}
+
+void Refresh::begin() noexcept
+{
+    // staged program is about to be rewritten, keep the timer off it
+    portENTER_CRITICAL(&m_lock);
+    m_pending = false;
+    portEXIT_CRITICAL(&m_lock);
+
+    m_programs[not m_playing].len = 0;
+}
+
+bool Refresh::add(std::span<const refresh_lamp_t> lamps, uint8_t hold) noexcept
+{
+    program_t& program = m_programs[not m_playing];
+    if (program.len >= REFRESH_MAX_KEYFRAMES)
+        return false;
+
+    schedule_t& frame = program.frames[program.len];
+    memset(frame, 0, sizeof(frame));
+    for (uint8_t slot = 0; slot < REFRESH_SLOTS; slot++)
+    {
+        for (const auto& lamp: lamps)
+        {
+            uint8_t on = refresh_gamma[lamp.level];
+            uint8_t bits;
+            if (slot >= on)
+                bits = lamp.blank;
+            else
+                bits = slot * REFRESH_SLOTS < on * lamp.mix ? lamp.lit : lamp.from;
+            frame[slot][lamp.port] |= bits;
+        }
+    }
+    program.hold[program.len++] = hold;
+    return true;
+}
+
+bool Refresh::commit() noexcept
+{
+    program_t& program = m_programs[not m_playing];
+    if (not program.len)
+        return false;
+    program.hold[program.len - 1] = 0;
+
+    portENTER_CRITICAL(&m_lock);
+    m_pending = true;
+    portEXIT_CRITICAL(&m_lock);
+
+    m_stats.programs++;
+    // the timer keeps running while m_pending is set, a stopped one is started again
+    return start();
+}
+
+void Refresh::log_stats() noexcept
+{
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed_ms = (now - m_reported_us) / 1000;
+    if (elapsed_ms <= 0)
+        return;
+
+    ESP_LOGI(TAG, "per second: %lu writes, %lu dropped, %lu cycles; %lu programs%s",
+             (unsigned long)((m_stats.writes - m_reported.writes) * 1000 / elapsed_ms),
+             (unsigned long)((m_stats.dropped - m_reported.dropped) * 1000 / elapsed_ms),
+             (unsigned long)((m_stats.cycles - m_reported.cycles) * 1000 / elapsed_ms),
+             (unsigned long)(m_stats.programs - m_reported.programs),
+             active() ? "; timer running, light sleep blocked" : "");
+
+    m_reported    = m_stats;
+    m_reported_us = now;
+}
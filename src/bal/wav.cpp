@@ -0,0 +1,158 @@
+#include <cstring>
+
+#include "wav.h"
+
+static constexpr int16_t adpcm_step[89] = {
+        7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+        50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+        337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+        2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+        15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+static constexpr int8_t adpcm_index[16] = {-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+
+static uint16_t le16(const uint8_t* p)
+{
+    return p[0] | p[1] << 8;
+}
+
+static uint32_t le32(const uint8_t* p)
+{
+    return p[0] | p[1] << 8 | p[2] << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+static uint8_t to_dac(int32_t sample)
+{
+    return static_cast<uint8_t>((sample >> 8) + WAV_SILENCE);
+}
+
+size_t wav_parse(const uint8_t* file, size_t size, wav_info_t& out) noexcept
+{
+    if (size < 12 or memcmp(file, "RIFF", 4) or memcmp(file + 8, "WAVE", 4))
+        return 0;
+
+    size_t total = le32(file + 4) + 8;
+    total += total & 1;
+    size = total < size ? total : size;
+
+    bool has_fmt = false;
+    for (size_t pos = 12; pos + 8 <= size;)
+    {
+        const uint8_t* chunk = file + pos;
+        size_t len = le32(chunk + 4);
+        if (len > size - pos - 8)
+            return 0;
+
+        if (not memcmp(chunk, "fmt ", 4) and len >= 16)
+        {
+            out.format      = le16(chunk + 8);
+            out.rate_hz     = le32(chunk + 12);
+            out.block_align = le16(chunk + 20);
+            out.bits        = le16(chunk + 22);
+            if (le16(chunk + 10) != 1)
+                return 0;
+            has_fmt = true;
+        }
+        else if (not memcmp(chunk, "data", 4) and has_fmt)
+        {
+            out.data = chunk + 8;
+            out.size = len;
+
+            bool pcm   = out.format == WAV_FORMAT_PCM and (out.bits == 8 or out.bits == 16);
+            bool adpcm = out.format == WAV_FORMAT_IMA_ADPCM and out.bits == 4 and out.block_align > 4;
+            return (pcm or adpcm) and out.rate_hz ? total : 0;
+        }
+        // chunks are word aligned
+        pos += 8 + len + (len & 1);
+    }
+    return 0;
+}
+
+void WavDecoder::begin(const wav_info_t& wav) noexcept
+{
+    m_wav        = wav;
+    m_pos        = 0;
+    m_block_left = 0;
+    m_high       = false;
+}
+
+size_t WavDecoder::decode_adpcm(uint8_t* out, size_t max) noexcept
+{
+    size_t  num       = 0;
+    int32_t predictor = m_predictor;
+    int32_t index     = m_index;
+
+    while (num < max)
+    {
+        uint8_t nibble;
+        if (m_high)
+        {
+            nibble = m_byte >> 4;
+            m_high = false;
+        }
+        else if (m_block_left)
+        {
+            m_byte = m_wav.data[m_pos++];
+            m_block_left--;
+            nibble = m_byte & 0x0F;
+            m_high = true;
+        }
+        else
+        {
+            // block header holds the first sample as is
+            if (m_wav.size - m_pos < 4)
+                break;
+            const uint8_t* header = m_wav.data + m_pos;
+            predictor = static_cast<int16_t>(le16(header));
+            index     = header[2] < 89 ? header[2] : 88;
+            m_pos += 4;
+
+            size_t left  = m_wav.size - m_pos;
+            m_block_left = m_wav.block_align - 4u < left ? m_wav.block_align - 4u : left;
+            out[num++]   = to_dac(predictor);
+            continue;
+        }
+
+        int32_t step = adpcm_step[index];
+        int32_t diff = step >> 3;
+        if (nibble & 1)
+            diff += step >> 2;
+        if (nibble & 2)
+            diff += step >> 1;
+        if (nibble & 4)
+            diff += step;
+        predictor += nibble & 8 ? -diff : diff;
+        predictor = predictor < INT16_MIN ? INT16_MIN : predictor > INT16_MAX ? INT16_MAX : predictor;
+
+        index += adpcm_index[nibble];
+        index = index < 0 ? 0 : index > 88 ? 88 : index;
+
+        out[num++] = to_dac(predictor);
+    }
+
+    m_predictor = predictor;
+    m_index     = static_cast<int8_t>(index);
+    return num;
+}
+
+size_t WavDecoder::decode(uint8_t* out, size_t max) noexcept
+{
+    if (m_wav.format == WAV_FORMAT_IMA_ADPCM)
+        return decode_adpcm(out, max);
+
+    size_t width = m_wav.bits / 8;
+    size_t left  = (m_wav.size - m_pos) / width;
+    size_t num   = left < max ? left : max;
+    const uint8_t* in = m_wav.data + m_pos;
+
+    if (width == 1)
+        memcpy(out, in, num);
+    else
+    {
+        for (size_t i = 0; i < num; i++)
+            out[i] = to_dac(static_cast<int16_t>(le16(in + 2 * i)));
+    }
+    m_pos += num * width;
+    return num;
+}
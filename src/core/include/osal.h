@@ -155,6 +155,38 @@ namespace OSAL {
             return pdTRUE == xQueueSend(static_cast<QueueHandle_t>(handle), item_p, _ms2ticks(timeout_ms));
         }
 
+        /**
+         * @brief send item to queue from an interrupt, never blocks
+         *
+         * Yields on exit from the interrupt if a higher priority task was woken
+         */
+        [[nodiscard]] static bool send_from_isr(osal_queue_t handle, const T* item_p) noexcept
+        {
+            if(not handle or not item_p)
+                return false;
+
+            BaseType_t woken = pdFALSE;
+            bool ret = pdTRUE == xQueueSendFromISR(static_cast<QueueHandle_t>(handle), item_p, &woken);
+            portYIELD_FROM_ISR(woken);
+            return ret;
+        }
+
+        /**
+         * @brief send item to queue from a driver callback, never blocks
+         *
+         * Leaves the yield to the driver, which does it when the callback reports a woken task
+         */
+        [[nodiscard]] static bool send_from_isr(osal_queue_t handle, const T* item_p, bool& woken) noexcept
+        {
+            if(not handle or not item_p)
+                return false;
+
+            BaseType_t higher = pdFALSE;
+            bool ret = pdTRUE == xQueueSendFromISR(static_cast<QueueHandle_t>(handle), item_p, &higher);
+            woken = woken or pdTRUE == higher;
+            return ret;
+        }
+
         /**
          * @copydoc osal_queue_recv
          */
@@ -193,6 +225,33 @@ namespace OSAL {
             return send(m_handle, item_p, timeout_ms);
         }
 
+        /**
+         * @brief send item to queue from an interrupt
+         *
+         * @param [in] item_p pointer to item
+         *
+         * @retval true  success
+         * @retval false queue is full
+         */
+        [[nodiscard]] bool send_from_isr(const T* item_p) const noexcept
+        {
+            return send_from_isr(m_handle, item_p);
+        }
+
+        /**
+         * @brief send item to queue from a driver callback without yielding
+         *
+         * @param [in]  item_p pointer to item
+         * @param [out] woken  set if a higher priority task was woken, left as is otherwise
+         *
+         * @retval true  success
+         * @retval false queue is full
+         */
+        [[nodiscard]] bool send_from_isr(const T* item_p, bool& woken) const noexcept
+        {
+            return send_from_isr(m_handle, item_p, woken);
+        }
+
         /**
          * @brief receive item from queue
          *
@@ -0,0 +1,37 @@
+#ifndef EXPERIMENTS_POWER_H
+#define EXPERIMENTS_POWER_H
+
+#include <cstdint>
+
+#define POWER_ACTIVE_MA 30  ///< CPU idling awake at the default frequency, estimate for reports
+#define POWER_SLEEP_UA  800 ///< light sleep with the RTC timer and GPIO wakeup armed
+#define POWER_POLL_HZ   2   ///< button poll rate of the former polling design
+
+/**
+ * @brief light sleep statistics
+ */
+struct power_stats_t {
+    uint32_t wakeups;   ///< exits from light sleep
+    int64_t  slept_us;  ///< time spent in light sleep
+};
+
+/**
+ * @brief enable frequency scaling and automatic light sleep
+ *
+ * The CPU sleeps whenever every task waits longer than CONFIG_FREERTOS_IDLE_TIME_BEFORE_SLEEP
+ * ticks; esp_timer callbacks and armed GPIO levels wake it up. Call before the tasks start.
+ *
+ * @retval true  power management configured
+ * @retval false not supported by the configuration, the CPU stays awake
+ */
+bool power_init() noexcept;
+
+const power_stats_t& power_get_stats() noexcept;
+
+/**
+ * @brief log wakeups per minute and average current since the previous call,
+ *        compared with the tick driven polling design
+ */
+void power_log_stats() noexcept;
+
+#endif //EXPERIMENTS_POWER_H
@@ -0,0 +1,81 @@
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_pm.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+
+#include "power.h"
+
+static const char *TAG = "POWER";
+
+static power_stats_t _stats       = {};
+static power_stats_t _reported    = {};
+static int64_t       _reported_us = 0;
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+// runs with the scheduler stopped right after wakeup
+static IRAM_ATTR esp_err_t on_wakeup(int64_t slept_us, void*)
+{
+    _stats.wakeups++;
+    _stats.slept_us += slept_us;
+    return ESP_OK;
+}
+#endif
+
+bool power_init() noexcept
+{
+#if CONFIG_PM_ENABLE
+    const esp_pm_config_t config {
+        .max_freq_mhz       = CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ,
+        .min_freq_mhz       = CONFIG_XTAL_FREQ,
+        .light_sleep_enable = true,
+    };
+    if (ESP_OK != esp_pm_configure(&config))
+    {
+        ESP_LOGE(TAG, "Could not enable light sleep, is tickless idle on?");
+        return false;
+    }
+
+#if CONFIG_PM_LIGHT_SLEEP_CALLBACKS
+    esp_pm_sleep_cbs_register_config_t cbs {};
+    cbs.exit_cb = on_wakeup;
+    if (ESP_OK != esp_pm_light_sleep_register_cbs(&cbs))
+        ESP_LOGW(TAG, "Could not count light sleep wakeups");
+#endif
+    ESP_LOGI(TAG, "Light sleep enabled, %d - %d MHz", CONFIG_XTAL_FREQ, CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+    return true;
+#else
+    ESP_LOGW(TAG, "Power management is disabled in the configuration");
+    return false;
+#endif
+}
+
+const power_stats_t& power_get_stats() noexcept
+{
+    return _stats;
+}
+
+void power_log_stats() noexcept
+{
+    int64_t now_us     = esp_timer_get_time();
+    int64_t elapsed_us = now_us - _reported_us;
+    if (elapsed_us <= 0)
+        return;
+
+    power_stats_t stats = _stats;
+    int64_t wakeups  = stats.wakeups - _reported.wakeups;
+    int64_t slept_us = stats.slept_us - _reported.slept_us;
+    int64_t awake_us = elapsed_us - slept_us;
+
+    // polling: woken by every tick and button poll, never sleeping
+    int64_t avg_ua  = (awake_us * POWER_ACTIVE_MA * 1000 + slept_us * POWER_SLEEP_UA) / elapsed_us;
+    int64_t poll_ua = POWER_ACTIVE_MA * 1000;
+    ESP_LOGI(TAG, "%lld wakeups/min (polling %d), asleep %lld%%, ~%lld.%02lld mA (polling ~%lld mA)",
+             (long long)(wakeups * 60000000 / elapsed_us), (configTICK_RATE_HZ + POWER_POLL_HZ) * 60,
+             (long long)(slept_us * 100 / elapsed_us),
+             (long long)(avg_ua / 1000), (long long)(avg_ua % 1000 / 10), (long long)(poll_ua / 1000));
+
+    _reported    = stats;
+    _reported_us = now_us;
+}
@@ -0,0 +1,138 @@
+#include "ds3231.h"
+
+#include "esp_log.h"
+
+static const char* TAG = "DS3231";
+
+static uint8_t bcd2bin(uint8_t v) {
+    return (v >> 4) * 10 + (v & 0x0F);
+}
+
+static uint8_t bin2bcd(uint8_t v) {
+    return (v / 10) << 4 | v % 10;
+}
+
+/**
+ * Converts an error of the bus owner
+ * @param ret the error
+ * @return an error code or DS3231_ERR_OK if no error encountered
+*/
+static ds3231_err_t ds3231_error(esp_err_t ret) {
+    switch (ret) {
+        case ESP_OK:
+            return DS3231_ERR_OK;
+        case ESP_FAIL:
+            return DS3231_ERR_FAIL;
+        case ESP_ERR_TIMEOUT:
+            return DS3231_ERR_TIMEOUT;
+        default:
+            return DS3231_ERR_BUS;
+    }
+}
+
+/**
+ * Reads consecutive registers in one session
+ * @param rtc the DS3231 interface structure
+ * @param reg first register address
+ * @param data buffer for the values
+ * @param len number of registers
+ * @return an error code or DS3231_ERR_OK if no error encountered
+*/
+static ds3231_err_t ds3231_read(const ds3231_t *rtc, uint8_t reg, uint8_t *data, size_t len) {
+    if( not rtc->read )
+        return DS3231_ERR_BUS;
+    return ds3231_error(rtc->read(rtc->i2c_addr, reg, data, len));
+}
+
+/**
+ * Reads the time, the registers are latched on START
+ * so all of them belong to the same second
+ * @param rtc the DS3231 interface structure
+ * @param utc the time, day of the year and DST are not filled
+ * @return an error code, DS3231_ERR_INVALID if the oscillator
+ *         stopped since the last ds3231_set_time
+*/
+ds3231_err_t ds3231_get_time(const ds3231_t *rtc, struct tm *utc) {
+    uint8_t regs[DS3231_STATUS + 1];
+    ds3231_err_t ret = ds3231_read(rtc, DS3231_SECONDS, regs, sizeof(regs));
+    if( ret != DS3231_ERR_OK ) {
+        if( ret != DS3231_ERR_BUS )
+            ESP_LOGE(TAG, "ERROR: unable to read time from address %02x", rtc->i2c_addr);
+        return ret;
+    }
+
+    if( regs[DS3231_STATUS] & DS3231_STATUS_OSF ) {
+        ESP_LOGW(TAG, "Oscillator stopped, time was lost");
+        return DS3231_ERR_INVALID;
+    }
+
+    utc->tm_sec  = bcd2bin(regs[DS3231_SECONDS] & 0x7F);
+    utc->tm_min  = bcd2bin(regs[DS3231_MINUTES] & 0x7F);
+    utc->tm_hour = bcd2bin(regs[DS3231_HOURS] & 0x3F);
+    utc->tm_wday = (regs[DS3231_DAY] & 0x07) - 1;
+    utc->tm_mday = bcd2bin(regs[DS3231_DATE] & 0x3F);
+    utc->tm_mon  = bcd2bin(regs[DS3231_MONTH] & 0x1F) - 1;
+    utc->tm_year = bcd2bin(regs[DS3231_YEAR]) + (regs[DS3231_MONTH] & DS3231_MONTH_CENTURY ? 200 : 100);
+    utc->tm_yday  = 0;
+    utc->tm_isdst = 0;
+
+    if( regs[DS3231_HOURS] & DS3231_HOURS_12H
+        or utc->tm_sec > 59 or utc->tm_min > 59 or utc->tm_hour > 23
+        or utc->tm_mday < 1 or utc->tm_mday > 31 or utc->tm_mon < 0 or utc->tm_mon > 11 ) {
+        ESP_LOGW(TAG, "Time registers out of range");
+        return DS3231_ERR_INVALID;
+    }
+    return DS3231_ERR_OK;
+}
+
+/**
+ * Sets the time and clears the oscillator stop flag. Writing the
+ * seconds register restarts the second, call it on a second boundary
+ * @param rtc the DS3231 interface structure
+ * @param utc the time, years 2000 - 2199
+ * @return an error code or DS3231_ERR_OK if no error encountered
+*/
+ds3231_err_t ds3231_set_time(const ds3231_t *rtc, const struct tm *utc) {
+    if( utc->tm_year < 100 or utc->tm_year >= 300 )
+        return DS3231_ERR_INVALID;
+
+    if( not rtc->write )
+        return DS3231_ERR_BUS;
+
+    // alarms and control are rewritten as they are, status with OSF cleared
+    uint8_t regs[DS3231_STATUS + 1];
+    ds3231_err_t ret = ds3231_read(rtc, DS3231_YEAR + 1, regs + DS3231_YEAR + 1, DS3231_STATUS - DS3231_YEAR);
+    if( ret != DS3231_ERR_OK )
+        return ret;
+
+    regs[DS3231_SECONDS] = bin2bcd(utc->tm_sec);
+    regs[DS3231_MINUTES] = bin2bcd(utc->tm_min);
+    regs[DS3231_HOURS]   = bin2bcd(utc->tm_hour);
+    regs[DS3231_DAY]     = static_cast<uint8_t>(utc->tm_wday + 1);
+    regs[DS3231_DATE]    = bin2bcd(utc->tm_mday);
+    regs[DS3231_MONTH]   = static_cast<uint8_t>(bin2bcd(utc->tm_mon + 1) | (utc->tm_year >= 200 ? DS3231_MONTH_CENTURY : 0));
+    regs[DS3231_YEAR]    = bin2bcd(utc->tm_year % 100);
+    regs[DS3231_STATUS] &= ~DS3231_STATUS_OSF;
+
+    // time and status in one session
+    ret = ds3231_error(rtc->write(rtc->i2c_addr, DS3231_SECONDS, regs, sizeof(regs)));
+    if( ret != DS3231_ERR_OK )
+        ESP_LOGE(TAG, "ERROR: unable to write time to address %02x", rtc->i2c_addr);
+    return ret;
+}
+
+/**
+ * Reads the die temperature the oscillator is compensated for
+ * @param rtc the DS3231 interface structure
+ * @param centi_celsius temperature in 0.01 degree units, 0.25 degree resolution
+ * @return an error code or DS3231_ERR_OK if no error encountered
+*/
+ds3231_err_t ds3231_get_temperature(const ds3231_t *rtc, int16_t *centi_celsius) {
+    uint8_t temp[2];
+    ds3231_err_t ret = ds3231_read(rtc, DS3231_TEMP_MSB, temp, sizeof(temp));
+    if( ret != DS3231_ERR_OK )
+        return ret;
+
+    *centi_celsius = static_cast<int8_t>(temp[0]) * 100 + (temp[1] >> 6) * 25;
+    return DS3231_ERR_OK;
+}
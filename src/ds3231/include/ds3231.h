@@ -0,0 +1,79 @@
+#ifndef EXPERIMENTS_DS3231_H
+#define EXPERIMENTS_DS3231_H
+
+#include <time.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+// registers
+#define DS3231_SECONDS 		0x00
+#define DS3231_MINUTES 		0x01
+#define DS3231_HOURS 		0x02
+#define DS3231_DAY 			0x03
+#define DS3231_DATE 		0x04
+#define DS3231_MONTH 		0x05
+#define DS3231_YEAR 		0x06
+#define DS3231_CONTROL 		0x0E
+#define DS3231_STATUS 		0x0F
+#define DS3231_TEMP_MSB 	0x11
+#define DS3231_TEMP_LSB 	0x12
+
+#define DS3231_REG_NUM      0x13
+
+// register bits
+#define DS3231_HOURS_12H    0x40  // 12 hour mode, never set by this driver
+#define DS3231_MONTH_CENTURY 0x80 // year register rolled over 99
+#define DS3231_STATUS_OSF   0x80  // oscillator stopped, time is not valid
+
+#define DS3231_DEFAULT_ADDR    0x68
+
+/*
+   ds3231_err_t
+
+   Specifies an error code returned by functions
+   in the DS3231 API
+*/
+typedef enum {
+    DS3231_ERR_OK      = 0x00,
+    DS3231_ERR_BUS     = 0x01,  // bus owner isn't there or refused the transfer
+    DS3231_ERR_FAIL    = 0x02,  // not acknowledged, no device
+    DS3231_ERR_TIMEOUT = 0x03,
+    DS3231_ERR_INVALID = 0x04   // oscillator stopped or registers out of range
+} ds3231_err_t;
+
+/*
+   ds3231_read_t, ds3231_write_t
+
+   Register access provided by the owner of the shared bus.
+   Return ESP_OK, ESP_FAIL when not acknowledged,
+   ESP_ERR_TIMEOUT or any other error when the bus failed.
+*/
+typedef esp_err_t (*ds3231_read_t)(uint8_t i2c_addr, uint8_t reg, uint8_t *data, size_t len);
+typedef esp_err_t (*ds3231_write_t)(uint8_t i2c_addr, uint8_t reg, const uint8_t *data, size_t len);
+
+/*
+   ds3231_t
+
+   Specifies an interface configuration. The bus is shared:
+   this driver never touches it, every transfer goes through
+   the functions of the bus owner.
+*/
+typedef struct {
+    uint8_t i2c_addr;
+    ds3231_read_t read;
+    ds3231_write_t write;
+} ds3231_t;
+
+/*
+
+   Function prototypes
+
+*/
+ds3231_err_t ds3231_get_time(const ds3231_t *rtc, struct tm *utc);
+ds3231_err_t ds3231_set_time(const ds3231_t *rtc, const struct tm *utc);
+ds3231_err_t ds3231_get_temperature(const ds3231_t *rtc, int16_t *centi_celsius);
+
+#endif //EXPERIMENTS_DS3231_H
@@ -32,6 +32,7 @@
 #define MCP23017_OLATB 		0x15
 
 #define MCP23017_DEFAULT_ADDR	0x20
+#define MCP23017_I2C_CLK_HZ     400000
 
 /*
    mcp23017_err_t
@@ -43,9 +44,35 @@ typedef enum {
     MCP23017_ERR_OK      = 0x00,
     MCP23017_ERR_CONFIG  = 0x01,
     MCP23017_ERR_INSTALL = 0x02,
-    MCP23017_ERR_FAIL    = 0x03
+    MCP23017_ERR_FAIL    = 0x03,
+    MCP23017_ERR_TIMEOUT = 0x04,
+    MCP23017_ERR_BREAKER = 0x05
 } mcp23017_err_t;
 
+/*
+   Bus error recovery
+
+   Every transfer is given a short timeout and retried with
+   exponential backoff. A timeout with SDA or SCL held low is
+   treated as a stuck bus and recovered with SCL pulses. After
+   MCP23017_BREAKER_THRESHOLD failed calls in a row the circuit
+   breaker opens and calls fail fast for the cooldown period.
+*/
+#define MCP23017_I2C_TIMEOUT_MS      20
+#define MCP23017_MAX_RETRIES         3
+#define MCP23017_BACKOFF_US          200
+#define MCP23017_BREAKER_THRESHOLD   5
+#define MCP23017_BREAKER_COOLDOWN_MS 2000
+
+/*
+   Other devices on the bus
+
+   mcp23017_device_read/mcp23017_device_write let the owner of
+   the expander talk to other devices of its bus with the same
+   retries and stuck bus recovery. Each device keeps its own
+   health, an absent device never opens the expander's breaker.
+*/
+
 /*
    R/W bits
 */
@@ -95,6 +122,24 @@ typedef enum {
     GPIOB = 0x01
 } mcp23017_gpio_t;
 
+/*
+   mcp23017_health_t
+
+   Per-device bus health counters
+*/
+typedef struct {
+    uint32_t transfers;             // successful transfers
+    uint32_t failures;              // calls failed after all retries
+    uint32_t nacks;                 // attempts not acknowledged by device
+    uint32_t timeouts;              // attempts timed out (bus busy, clock stretch)
+    uint32_t retries;               // attempts repeated after an error
+    uint32_t bus_resets;            // stuck bus recoveries
+    uint32_t breaker_trips;         // times the circuit breaker opened
+    uint32_t breaker_rejects;       // calls rejected while breaker was open
+    uint8_t  consecutive_failures;  // failed calls since last success
+    int64_t  breaker_open_until_us; // breaker is open until this esp_timer time
+} mcp23017_health_t;
+
 /*
    mcp23017_t
 
@@ -107,17 +152,36 @@ typedef struct {
     uint8_t scl_pin;
     gpio_pullup_t sda_pullup_en;
     gpio_pullup_t scl_pullup_en;
+    mcp23017_health_t health;
 } mcp23017_t;
 
+/*
+   mcp23017_burst_t
+
+   Specifies a run of consecutive registers
+   written in one sequential transfer
+   (IOCON.BANK = 0, IOCON.SEQOP = 0)
+*/
+typedef struct {
+    uint8_t addr;          // first register address
+    uint8_t len;           // number of registers
+    const uint8_t *data;   // values to write
+} mcp23017_burst_t;
+
 /*
 
    Function prototypes
 
 */
+uint8_t mcp23017_register(mcp23017_reg_t reg, mcp23017_gpio_t group);
 mcp23017_err_t mcp23017_init(mcp23017_t *mcp);
 mcp23017_err_t mcp23017_write_register(mcp23017_t *mcp, mcp23017_reg_t reg, mcp23017_gpio_t group, uint8_t v);
+mcp23017_err_t mcp23017_write_bursts(mcp23017_t *mcp, const mcp23017_burst_t *bursts, size_t num);
 mcp23017_err_t mcp23017_read_register(mcp23017_t *mcp, mcp23017_reg_t reg, mcp23017_gpio_t group, uint8_t *data);
+mcp23017_err_t mcp23017_device_read(mcp23017_t *mcp, mcp23017_health_t *health, uint8_t i2c_addr, uint8_t reg, uint8_t *data, size_t len);
+mcp23017_err_t mcp23017_device_write(mcp23017_t *mcp, mcp23017_health_t *health, uint8_t i2c_addr, uint8_t reg, const uint8_t *data, size_t len);
 mcp23017_err_t mcp23017_set_bit(mcp23017_t *mcp, uint8_t bit, mcp23017_reg_t reg, mcp23017_gpio_t group);
 mcp23017_err_t mcp23017_clear_bit(mcp23017_t *mcp, uint8_t bit, mcp23017_reg_t reg, mcp23017_gpio_t group);
+void mcp23017_log_health(const mcp23017_t *mcp);
 
 #endif //EXPERIMENTS_MCP23017_H
@@ -1,9 +1,13 @@
 #include "mcp23017.h"
 
+#include <cstring>
+
 #include <driver/gpio.h>
 #include <driver/i2c.h>
 
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
 
 static const char* TAG = "MCP23017";
 
@@ -23,11 +27,11 @@ uint8_t mcp23017_register(mcp23017_reg_t reg, mcp23017_gpio_t group) {
 }
 
 /**
- * Initializes the MCP23017
+ * Configures the I2C controller and installs the driver
  * @param mcp the MCP23017 interface structure
  * @return an error code or MCP23017_ERR_OK if no error encountered
 */
-mcp23017_err_t mcp23017_init(mcp23017_t *mcp) {
+static mcp23017_err_t mcp23017_bus_install(mcp23017_t *mcp) {
 
     esp_err_t ret;
 
@@ -38,7 +42,7 @@ mcp23017_err_t mcp23017_init(mcp23017_t *mcp) {
             .scl_io_num = mcp->scl_pin,
             .sda_pullup_en = static_cast<bool>(mcp->sda_pullup_en),
             .scl_pullup_en = static_cast<bool>(mcp->scl_pullup_en),
-            .master = { .clk_speed = 100000 }
+            .master = { .clk_speed = MCP23017_I2C_CLK_HZ }
     };
     ret = i2c_param_config(mcp->port, &conf);
 
@@ -57,6 +61,127 @@ mcp23017_err_t mcp23017_init(mcp23017_t *mcp) {
     }
     ESP_LOGV(TAG,"I2C DRIVER INSTALLED");
 
+    return MCP23017_ERR_OK;
+}
+
+/**
+ * Checks whether a slave holds SDA or SCL low on an idle bus
+ * @param mcp the MCP23017 interface structure
+ * @return true if the bus is stuck
+*/
+static bool mcp23017_bus_stuck(const mcp23017_t *mcp) {
+    return not gpio_get_level(static_cast<gpio_num_t>(mcp->sda_pin))
+        or not gpio_get_level(static_cast<gpio_num_t>(mcp->scl_pin));
+}
+
+/**
+ * Recovers a stuck bus: releases the driver, clocks SCL until the slave
+ * lets SDA go (at most 9 pulses), generates STOP and reinstalls the driver
+ * @param mcp the MCP23017 interface structure
+*/
+static void mcp23017_bus_recover(mcp23017_t *mcp) {
+    auto sda = static_cast<gpio_num_t>(mcp->sda_pin);
+    auto scl = static_cast<gpio_num_t>(mcp->scl_pin);
+
+    ESP_LOGW(TAG,"Bus stuck (SDA %d, SCL %d), recovering", gpio_get_level(sda), gpio_get_level(scl));
+    i2c_driver_delete(mcp->port);
+
+    gpio_set_direction(sda, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_direction(scl, GPIO_MODE_INPUT_OUTPUT_OD);
+    gpio_set_level(sda, 1);
+    gpio_set_level(scl, 1);
+    esp_rom_delay_us(5);
+
+    for (uint8_t i = 0; i < 9 and not gpio_get_level(sda); i++) {
+        gpio_set_level(scl, 0);
+        esp_rom_delay_us(5);
+        gpio_set_level(scl, 1);
+        esp_rom_delay_us(5);
+    }
+
+    // STOP condition: SDA rises while SCL is high
+    gpio_set_level(scl, 0);
+    esp_rom_delay_us(5);
+    gpio_set_level(sda, 0);
+    esp_rom_delay_us(5);
+    gpio_set_level(scl, 1);
+    esp_rom_delay_us(5);
+    gpio_set_level(sda, 1);
+    esp_rom_delay_us(5);
+
+    mcp23017_bus_install(mcp);
+    mcp->health.bus_resets++;
+}
+
+/**
+ * Executes a command link with bounded retries, stuck bus recovery
+ * and circuit breaker
+ * @param mcp the MCP23017 interface structure, owner of the bus
+ * @param health counters and breaker of the addressed device
+ * @param cmd the command link to execute
+ * @return an error code or MCP23017_ERR_OK if no error encountered
+*/
+static mcp23017_err_t mcp23017_transfer(mcp23017_t *mcp, mcp23017_health_t *health, i2c_cmd_handle_t cmd) {
+    int64_t now = esp_timer_get_time();
+
+    if( health->breaker_open_until_us > now ) {
+        health->breaker_rejects++;
+        return MCP23017_ERR_BREAKER;
+    }
+
+    esp_err_t ret = ESP_FAIL;
+    for (uint8_t attempt = 0; attempt <= MCP23017_MAX_RETRIES; attempt++) {
+        if( attempt ) {
+            health->retries++;
+            esp_rom_delay_us(MCP23017_BACKOFF_US << (attempt - 1));
+        }
+
+        ret = i2c_master_cmd_begin(mcp->port, cmd, pdMS_TO_TICKS(MCP23017_I2C_TIMEOUT_MS));
+        if( ret == ESP_OK )
+            break;
+
+        if( ret == ESP_FAIL ) {
+            health->nacks++;
+        } else {
+            health->timeouts++;
+            if( mcp23017_bus_stuck(mcp) )
+                mcp23017_bus_recover(mcp);
+        }
+    }
+
+    if( ret == ESP_OK ) {
+        health->transfers++;
+        health->consecutive_failures = 0;
+        return MCP23017_ERR_OK;
+    }
+
+    health->failures++;
+    if( health->consecutive_failures < UINT8_MAX )
+        health->consecutive_failures++;
+
+    // stays armed after the cooldown: one more failure reopens the breaker
+    if( health->consecutive_failures >= MCP23017_BREAKER_THRESHOLD ) {
+        health->breaker_trips++;
+        health->breaker_open_until_us = now + MCP23017_BREAKER_COOLDOWN_MS * 1000LL;
+        ESP_LOGE(TAG,"Circuit breaker open for %d ms (%s)", MCP23017_BREAKER_COOLDOWN_MS, esp_err_to_name(ret));
+    }
+
+    return ret == ESP_FAIL ? MCP23017_ERR_FAIL : MCP23017_ERR_TIMEOUT;
+}
+
+/**
+ * Initializes the MCP23017
+ * @param mcp the MCP23017 interface structure
+ * @return an error code or MCP23017_ERR_OK if no error encountered
+*/
+mcp23017_err_t mcp23017_init(mcp23017_t *mcp) {
+
+    memset(&mcp->health, 0, sizeof(mcp->health));
+
+    mcp23017_err_t ret = mcp23017_bus_install(mcp);
+    if( ret != MCP23017_ERR_OK )
+        return ret;
+
     // make all I/O's output
     mcp23017_write_register(mcp, MCP23017_IODIR, GPIOA, 0x00);
     mcp23017_write_register(mcp, MCP23017_IODIR, GPIOB, 0x00);
@@ -80,11 +205,40 @@ mcp23017_err_t mcp23017_write_register(mcp23017_t *mcp, mcp23017_reg_t reg, mcp2
     i2c_master_write_byte(cmd, r, ACK_CHECK_EN);
     i2c_master_write_byte(cmd, v, ACK_CHECK_EN);
     i2c_master_stop(cmd);
-    esp_err_t ret = i2c_master_cmd_begin(mcp->port, cmd, 1000 / portTICK_PERIOD_MS);
+    mcp23017_err_t ret = mcp23017_transfer(mcp, &mcp->health, cmd);
     i2c_cmd_link_delete(cmd);
-    if (ret == ESP_FAIL) {
+    if (ret != MCP23017_ERR_OK) {
         ESP_LOGE(TAG,"ERROR: unable to write to register");
-        return MCP23017_ERR_FAIL;
+        return ret;
+    }
+    return MCP23017_ERR_OK;
+}
+
+/**
+ * Writes runs of consecutive registers in one I2C session,
+ * separated by repeated START conditions
+ * @param mcp the MCP23017 interface structure
+ * @param bursts the register runs to write
+ * @param num number of runs
+ * @return an error code or MCP23017_ERR_OK if no error encountered
+*/
+mcp23017_err_t mcp23017_write_bursts(mcp23017_t *mcp, const mcp23017_burst_t *bursts, size_t num) {
+    if( not num )
+        return MCP23017_ERR_OK;
+
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    for (size_t i = 0; i < num; i++) {
+        i2c_master_start(cmd);
+        i2c_master_write_byte(cmd, mcp->i2c_addr << 1 | WRITE_BIT, ACK_CHECK_EN);
+        i2c_master_write_byte(cmd, bursts[i].addr, ACK_CHECK_EN);
+        i2c_master_write(cmd, bursts[i].data, bursts[i].len, ACK_CHECK_EN);
+    }
+    i2c_master_stop(cmd);
+    mcp23017_err_t ret = mcp23017_transfer(mcp, &mcp->health, cmd);
+    i2c_cmd_link_delete(cmd);
+    if (ret != MCP23017_ERR_OK) {
+        ESP_LOGE(TAG,"ERROR: unable to write %u register runs", (unsigned)num);
+        return ret;
     }
     return MCP23017_ERR_OK;
 }
@@ -106,27 +260,77 @@ mcp23017_err_t mcp23017_read_register(mcp23017_t *mcp, mcp23017_reg_t reg, mcp23
     i2c_master_write_byte(cmd, (mcp->i2c_addr << 1) | I2C_MASTER_WRITE, ACK_CHECK_EN);
     i2c_master_write_byte(cmd, r, 1);
     i2c_master_stop(cmd);
-    esp_err_t ret =i2c_master_cmd_begin(mcp->port, cmd, 1000 / portTICK_PERIOD_MS);
+    mcp23017_err_t ret = mcp23017_transfer(mcp, &mcp->health, cmd);
     i2c_cmd_link_delete(cmd);
-    if( ret == ESP_FAIL ) {
+    if( ret != MCP23017_ERR_OK ) {
         ESP_LOGE(TAG,"ERROR: unable to write address %02x to read reg %02x",mcp->i2c_addr,r);
-        return MCP23017_ERR_FAIL;
+        return ret;
     }
 
     cmd = i2c_cmd_link_create();
     i2c_master_start(cmd);
     i2c_master_write_byte(cmd, (mcp->i2c_addr << 1) | I2C_MASTER_READ, ACK_CHECK_EN);
     i2c_master_read_byte(cmd, data, I2C_MASTER_NACK);
-    ret =i2c_master_cmd_begin(mcp->port, cmd, 1000 / portTICK_PERIOD_MS);
+    ret = mcp23017_transfer(mcp, &mcp->health, cmd);
     i2c_cmd_link_delete(cmd);
-    if( ret == ESP_FAIL ) {
+    if( ret != MCP23017_ERR_OK ) {
         ESP_LOGE(TAG,"ERROR: unable to read reg %02x from address %02x",r,mcp->i2c_addr);
-        return MCP23017_ERR_FAIL;
+        return ret;
     }
 
     return MCP23017_ERR_OK;
 }
 
+/**
+ * Reads consecutive registers of another device on the bus in one session
+ * @param mcp the MCP23017 interface structure, owner of the bus
+ * @param health counters and breaker of the device
+ * @param i2c_addr address of the device
+ * @param reg first register address
+ * @param data buffer for the values
+ * @param len number of registers
+ * @return an error code or MCP23017_ERR_OK if no error encountered
+*/
+mcp23017_err_t mcp23017_device_read(mcp23017_t *mcp, mcp23017_health_t *health, uint8_t i2c_addr, uint8_t reg, uint8_t *data, size_t len) {
+    if( not len )
+        return MCP23017_ERR_OK;
+
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, i2c_addr << 1 | WRITE_BIT, ACK_CHECK_EN);
+    i2c_master_write_byte(cmd, reg, ACK_CHECK_EN);
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, i2c_addr << 1 | READ_BIT, ACK_CHECK_EN);
+    i2c_master_read(cmd, data, len, I2C_MASTER_LAST_NACK);
+    i2c_master_stop(cmd);
+    mcp23017_err_t ret = mcp23017_transfer(mcp, health, cmd);
+    i2c_cmd_link_delete(cmd);
+    return ret;
+}
+
+/**
+ * Writes consecutive registers of another device on the bus in one session
+ * @param mcp the MCP23017 interface structure, owner of the bus
+ * @param health counters and breaker of the device
+ * @param i2c_addr address of the device
+ * @param reg first register address
+ * @param data values to write
+ * @param len number of registers
+ * @return an error code or MCP23017_ERR_OK if no error encountered
+*/
+mcp23017_err_t mcp23017_device_write(mcp23017_t *mcp, mcp23017_health_t *health, uint8_t i2c_addr, uint8_t reg, const uint8_t *data, size_t len) {
+    i2c_cmd_handle_t cmd = i2c_cmd_link_create();
+    i2c_master_start(cmd);
+    i2c_master_write_byte(cmd, i2c_addr << 1 | WRITE_BIT, ACK_CHECK_EN);
+    i2c_master_write_byte(cmd, reg, ACK_CHECK_EN);
+    if( len )
+        i2c_master_write(cmd, data, len, ACK_CHECK_EN);
+    i2c_master_stop(cmd);
+    mcp23017_err_t ret = mcp23017_transfer(mcp, health, cmd);
+    i2c_cmd_link_delete(cmd);
+    return ret;
+}
+
 /**
  * Clears a bit from a current register value
  * @param mcp address of the MCP23017 data structure
@@ -173,4 +377,17 @@ mcp23017_err_t mcp23017_clear_bit(mcp23017_t *mcp, uint8_t bit, mcp23017_reg_t r
         return MCP23017_ERR_FAIL;
     }
     return MCP23017_ERR_OK;
-}
\ No newline at end of file
+}
+
+/**
+ * Logs bus health counters of the device
+ * @param mcp address of the MCP23017 data structure
+*/
+void mcp23017_log_health(const mcp23017_t *mcp) {
+    const mcp23017_health_t *h = &mcp->health;
+    ESP_LOGI(TAG, "addr %02x: ok %lu, failed %lu, nack %lu, timeout %lu, retry %lu, reset %lu, trip %lu, rejected %lu",
+             mcp->i2c_addr,
+             (unsigned long)h->transfers, (unsigned long)h->failures, (unsigned long)h->nacks,
+             (unsigned long)h->timeouts, (unsigned long)h->retries, (unsigned long)h->bus_resets,
+             (unsigned long)h->breaker_trips, (unsigned long)h->breaker_rejects);
+}
@@ -1,20 +1,24 @@
 #include <array>
 #include <ctime>
 #include <cstdlib>
+#include <cstring>
 
 #include "RTC_time.h"
+#include "calendar.h"
+#include "tz.h"
+#include "net.h"
+#include "ntp.h"
+#include "holdover.h"
+#include "discipline.h"
+#include "power.h"
+#include "timesource.h"
+#include "rtc_source.h"
+#include "alarm.h"
 
-//SNTP
 #include <sys/time.h>
-#include "esp_attr.h"
 
-//wifi
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
-#include "freertos/event_groups.h"
-#include "esp_system.h"
-#include "esp_wifi.h"
-#include "esp_event.h"
 #include "esp_log.h"
 #include "nvs_flash.h"
 
@@ -22,26 +26,23 @@
 
 #define MAX_CALLBACKS 5
 
-static const char *TAG = "TIMER";
-
-#define EXAMPLE_ESP_WIFI_SSID      "iHomeWave"
-#define EXAMPLE_ESP_WIFI_PASS      "b@r@b01@"
-
-static EventGroupHandle_t s_wifi_event_group;
-
-static uint8_t s_retry_num = 0;
+#define TIMER_DEFAULT_PERIOD_S  60  ///< dial shows minutes
+#define TIMER_REPORT_BOUNDARIES 60  ///< boundaries between error reports
+#define TIMER_DEFAULT_TZ        "EET-2EEST,M3.5.0/3,M10.5.0/4"  ///< Kyiv
+#define TIMER_VALID_TIME        1451606400  ///< 2016-01-01, earlier time was never set
 
-#define WIFI_CONNECTED_BIT        BIT0
-#define WIFI_FAIL_BIT             BIT1
-#define EXAMPLE_ESP_MAXIMUM_RETRY 3
+static const char *TAG = "TIMER";
 
 static std::array<std::pair<timer_event_t, timer_cb_t>, MAX_CALLBACKS> callbacks;
 static size_t callback_num = 0;
+static alarm_cb_t alarm_callback = nullptr;
 
 static class Timer* _task_timer = nullptr;
+static Ntp*         _ntp = nullptr;
+static Gps*         _gps = nullptr;
 
-extern "C" int setenv (const char *__string, const char *__value, int __overwrite);
-extern "C" void tzset();
+static Calendar _calendar;
+static Alarms   _alarms;
 
 class Timer final : public OSAL::Task
 {
@@ -49,24 +50,22 @@ public:
     OSAL::Queue<timer_msg_t, 10> m_queue {nullptr};
 
 private:
-    struct current_time {
-        uint8_t hour;
-        uint8_t min;
-        uint8_t sec;
-
-        bool operator== (const current_time& rhs) const noexcept
-        {
-            return hour == rhs.hour and min == rhs.min;
-        }
-
-        bool operator== (const tm& rhs) const noexcept
-        {
-            return hour == rhs.tm_hour and min == rhs.tm_min;
-        }
-
-    };
-
-    current_time now;
+    uint8_t  m_period_s = TIMER_DEFAULT_PERIOD_S;
+    int64_t  m_deadline_us = 0;     ///< wall clock time of the next boundary
+
+    uint32_t m_boundaries = 0;      ///< boundaries since the last report
+    uint32_t m_wakeups = 0;         ///< task wakeups since the last report
+    int64_t  m_error_sum_us = 0;    ///< sum of boundary lateness
+    int64_t  m_error_max_us = 0;
+    bool     m_rtc_dirty = false;   ///< external RTC waits for the synced time
+    bool     m_alarms_ready = false;  ///< alarms are scheduled against a valid clock
+
+    void schedule() noexcept;
+    void on_boundary(int64_t late_us) noexcept;
+    void dispatch() noexcept;
+    void handle(const timer_msg_t& msg) noexcept;
+    void schedule_alarms() noexcept;
+    void synced(uint32_t uncertainty_us) noexcept;
 
 public:
     explicit Timer() noexcept : OSAL::Task{} {}
@@ -77,225 +76,286 @@ private:
     void teardown() noexcept final;
 };
 
-static void time_sync_notification_cb(timeval *tv)
+static int64_t wall_time_us()
 {
-    ESP_LOGI(TAG, "Time synchronized event");
-}
-
-static void event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
-{
-    if (event_base == WIFI_EVENT)
-    {
-        switch (event_id)
-        {
-            case WIFI_EVENT_STA_START:
-            {
-                esp_wifi_connect();
-                break;
-            }
-            case WIFI_EVENT_STA_DISCONNECTED:
-            {
-                if (s_retry_num < EXAMPLE_ESP_MAXIMUM_RETRY)
-                {
-                    esp_wifi_connect();
-                    s_retry_num++;
-                    ESP_LOGI(TAG, "retry to connect to the AP");
-                } else {
-                    xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
-                }
-                ESP_LOGI(TAG,"connect to the AP fail");
-                break;
-            }
-        }
-    } else if (event_base == IP_EVENT)
-    {
-        switch (event_id)
-        {
-            case IP_EVENT_STA_GOT_IP:
-            {
-                s_retry_num = 0;
-                auto* event = static_cast<ip_event_got_ip_t*>(event_data);
-                ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
-                xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
-            }
-        }
-    }
+    timeval tv;
+    gettimeofday(&tv, nullptr);
+    return static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
 }
 
-static void wifi_init_sta()
+static void on_sample(time_source_t source, int64_t offset_us, uint32_t uncertainty_us)
 {
-    s_wifi_event_group = xEventGroupCreate();
-
-    ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
-
-    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
-    ESP_ERROR_CHECK(esp_wifi_init(&cfg));
-
-    esp_event_handler_instance_t instance_any_id;
-    esp_event_handler_instance_t instance_got_ip;
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
-                                                        ESP_EVENT_ANY_ID,
-                                                        &event_handler,
-                                                        nullptr,
-                                                        &instance_any_id));
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT,
-                                                        IP_EVENT_STA_GOT_IP,
-                                                        &event_handler,
-                                                        nullptr,
-                                                        &instance_got_ip));
-
-    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
-                                                        WIFI_EVENT_STA_DISCONNECTED,
-                                                        &event_handler,
-                                                        nullptr,
-                                                        nullptr));
-
-    wifi_config_t wifi_config = {
-        .sta = {
-            .ssid = EXAMPLE_ESP_WIFI_SSID,
-            .password = EXAMPLE_ESP_WIFI_PASS,
-            .threshold {
-                    .authmode = WIFI_AUTH_WPA2_PSK
-            },
-            .pmf_cfg = {
-                    .capable  = true,
-                    .required = false
+    // source selection and discipline live in the timer task, they are not shared with the sources
+    timer_msg_t msg {
+        .event = TIMER_SAMPLE,
+        .u = {
+            .sample = {
+                .source         = static_cast<uint8_t>(source),
+                .uncertainty_us = uncertainty_us,
+                .offset_us      = offset_us,
             },
         },
     };
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA) );
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config) );
-    ESP_ERROR_CHECK(esp_wifi_start() );
-
-    ESP_LOGI(TAG, "wifi_init_sta finished.");
-
-    EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
-                                           WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
-                                           pdFALSE,
-                                           pdFALSE,
-                                           portMAX_DELAY);
-
-    if (bits & WIFI_CONNECTED_BIT) {
-        ESP_LOGI(TAG, "connected to ap SSID:%s", EXAMPLE_ESP_WIFI_SSID);
-    } else if (bits & WIFI_FAIL_BIT) {
-        ESP_LOGI(TAG, "Failed to connect to SSID:%s", EXAMPLE_ESP_WIFI_SSID);
-    } else {
-        ESP_LOGE(TAG, "UNEXPECTED EVENT");
-    }
+    if (_task_timer and not _task_timer->m_queue.send(&msg, 0))
+        ESP_LOGW(TAG, "Could not pass %s sample", timesource_name(source));
+}
+
+static void get_time(tm& timeinfo)  {
 
-    ESP_ERROR_CHECK(esp_event_handler_instance_unregister(IP_EVENT, IP_EVENT_STA_GOT_IP, instance_got_ip));
-    ESP_ERROR_CHECK(esp_event_handler_instance_unregister(WIFI_EVENT, ESP_EVENT_ANY_ID, instance_any_id));
-    vEventGroupDelete(s_wifi_event_group);
+    time_t now;
+    time(&now);
+    static bool warned = false;
+    if (now < TIMER_VALID_TIME and not warned)
+        ESP_LOGW(TAG, "Time is not set yet, showing time since boot until synchronized");
+    warned = now < TIMER_VALID_TIME;
+
+    timeinfo = _calendar.advance(now);
 }
 
-static void init_sntp()
+void Timer::setup() noexcept
 {
-    ESP_LOGI(TAG, "Initializing SNTP");
-    esp_sntp_setoperatingmode(SNTP_OPMODE_POLL);
-    esp_sntp_setservername(0, "pool.ntp.org");
-    sntp_set_time_sync_notification_cb(time_sync_notification_cb);
-#ifdef CONFIG_SNTP_TIME_SYNC_METHOD_SMOOTH
-    sntp_set_sync_mode(SNTP_SYNC_MODE_SMOOTH);
-#endif
-    esp_sntp_init();
+    char tz[TZ_MAX_LEN];
+    if (not tz_load(tz) or not _calendar.set_tz(tz))
+        _calendar.set_tz(TIMER_DEFAULT_TZ);
+
+    // seed the clock before the network touches it
+    timesource_load();
+    holdover_restore_t restored = holdover_restore();
+    if (restored.source != HOLDOVER_NONE)
+        timesource_offer(TIME_SOURCE_HOLDOVER, restored.uncertainty_ms < 0 ? -1 : restored.uncertainty_ms * 1000);
+    rtc_source_restore();
+    discipline_init(holdover_drift_ppb());
+    _alarms.load();
+    schedule_alarms();
+
+    // show the clock right away, synchronization corrects it later
+    if (not net_start(_ntp))
+        ESP_LOGE(TAG, "Could not start network, time won't be synchronized");
+
+    dispatch();
+    schedule();
 }
 
-static void sync_system_time()
+void Timer::schedule() noexcept
 {
-    init_sntp();
-    time_t now = 0;
-    tm     timeinfo = { 0 };
-    int retry = 0;
-    const int retry_count = 10;
-    while (sntp_get_sync_status() == SNTP_SYNC_STATUS_RESET and ++retry < retry_count)
-    {
-        ESP_LOGI(TAG, "Waiting for system time to be set... (%d/%d)", retry, retry_count);
-        vTaskDelay(2000 / portTICK_PERIOD_MS);
-    }
-    time(&now);
-    localtime_r(&now, &timeinfo);
+    int64_t period_us = m_period_s * 1000000LL;
+    m_deadline_us = (wall_time_us() / period_us + 1) * period_us;
 }
 
-static void get_time(tm& timeinfo)  {
+void Timer::schedule_alarms() noexcept
+{
+    // time since boot would turn every alarm into a missed one
+    time_t now = time(nullptr);
+    m_alarms_ready = now >= TIMER_VALID_TIME;
+    if (m_alarms_ready)
+        _alarms.rebuild(now);
+}
 
-    time_t now;
-    time(&now);
-    localtime_r(&now, &timeinfo);
-    // Is time set? If not, tm_year will be (1970 - 1900).
-    if (timeinfo.tm_year < (2016 - 1900))
+void Timer::synced(uint32_t uncertainty_us) noexcept
+{
+    holdover_synced(uncertainty_us ? uncertainty_us : HOLDOVER_SYNC_UNCERTAINTY_US, discipline_drift_ppb());
+    m_rtc_dirty = true;
+    // scheduled alarms are UTC and survive a step, a late one still rings within ALARM_LATE_S
+    if (not m_alarms_ready)
+        schedule_alarms();
+    // a stepped clock invalidates the deadline and maybe the shown time
+    dispatch();
+    schedule();
+}
+
+void Timer::dispatch() noexcept
+{
+    tm timeinfo;
+    get_time(timeinfo);
+
+    for (size_t i = 0; i < callback_num; i++)
     {
-        ESP_LOGI(TAG, "Time is not set yet. Connecting to WiFi and getting time over NTP.");
-        sync_system_time();
-        time(&now);
+        if (callbacks[i].first == TIMER_SET_TIME)
+        {
+            callbacks[i].second(timeinfo);
+        }
     }
 
-    setenv("TZ", "GMT-3", 1);
-    tzset();
-    localtime_r(&now, &timeinfo);
+#ifdef PRINT_TIME
+    char strftime_buf[64];
+    strftime(strftime_buf, sizeof(strftime_buf), "%c", &timeinfo);
+    ESP_LOGI(TAG, "The current local date/time is: %s %s", strftime_buf, _calendar.zone());
+#endif
+}
+
+void Timer::on_boundary(int64_t late_us) noexcept
+{
+    m_boundaries++;
+    m_error_sum_us += late_us;
+    m_error_max_us = late_us > m_error_max_us ? late_us : m_error_max_us;
+
+    if (m_boundaries < TIMER_REPORT_BOUNDARIES)
+        return;
+
+    const calendar_stats_t& cal = _calendar.get_stats();
+    ESP_LOGI(TAG, "Boundary error: avg %lld us, max %lld us; %lu wakeups for %lu boundaries",
+             (long long)(m_error_sum_us / m_boundaries), (long long)m_error_max_us, (unsigned long)m_wakeups, (unsigned long)m_boundaries);
+    const discipline_stats_t& disc = discipline_get_stats();
+    ESP_LOGI(TAG, "Clock uncertainty %lld ms, drift %ld ppb, last offset %lld us, %lu syncs, %lu steps",
+             (long long)holdover_uncertainty_ms(), (long)discipline_drift_ppb(), (long long)disc.offset_us,
+             (unsigned long)disc.samples, (unsigned long)disc.steps);
+    _ntp->log_stats();
+    _gps->log_stats();
+    net_log_stats();
+    power_log_stats();
+    const rtc_source_stats_t& rtc = rtc_source_get_stats();
+    ESP_LOGI(TAG, "Time source %s; external RTC %s, %lu reads, %lu writes, %lu failures",
+             timesource_name(timesource_current()), rtc.present ? "present" : "absent",
+             (unsigned long)rtc.reads, (unsigned long)rtc.writes, (unsigned long)rtc.failures);
+    ESP_LOGI(TAG, "Calendar: %lu steps, %lu full conversions, %lu cycles per tick",
+             (unsigned long)cal.steps, (unsigned long)cal.resets,
+             (unsigned long)(cal.cycles / (cal.steps + cal.resets)));
+    m_boundaries   = 0;
+    m_wakeups      = 0;
+    m_error_sum_us = 0;
+    m_error_max_us = 0;
 }
 
-void Timer::setup() noexcept
+void Timer::handle(const timer_msg_t& msg) noexcept
 {
-    esp_err_t ret = nvs_flash_init();
-    if (ret == ESP_ERR_NVS_NO_FREE_PAGES or ret == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    switch (msg.event)
     {
-        ESP_ERROR_CHECK(nvs_flash_erase());
-        ret = nvs_flash_init();
+        case TIMER_SYNC:
+        {
+            _ntp->post(NTP_SYNC_NOW);
+            break;
+        }
+        case TIMER_SAMPLE:
+        {
+            auto source = static_cast<time_source_t>(msg.u.sample.source);
+            if (not timesource_offer(source, msg.u.sample.uncertainty_us))
+            {
+                ESP_LOGD(TAG, "%s sample not applied", timesource_name(source));
+                break;
+            }
+            discipline_offset(msg.u.sample.offset_us);
+            synced(msg.u.sample.uncertainty_us);
+            break;
+        }
+        case TIMER_SET_PERIOD:
+        {
+            if (msg.u.period_s != 1 and msg.u.period_s != 60)
+            {
+                ESP_LOGE(TAG, "Unsupported period %u s", msg.u.period_s);
+                break;
+            }
+            m_period_s = msg.u.period_s;
+            schedule();
+            break;
+        }
+        case TIMER_SET_TZ:
+        {
+            // the sender may have filled the whole field
+            char tz[TZ_MAX_LEN];
+            strncpy(tz, msg.u.tz, sizeof(tz) - 1);
+            tz[sizeof(tz) - 1] = '\0';
+            if (not _calendar.set_tz(tz))
+                break;
+            tz_save(tz);
+            if (m_alarms_ready)
+                _alarms.rebuild(time(nullptr));
+            dispatch();
+            schedule();
+            break;
+        }
+        case TIMER_SET_SERVERS:
+        {
+            ntp_msg_t ntp_msg {
+                .event = NTP_SET_SERVERS,
+                .u = {},
+            };
+            strncpy(ntp_msg.u.servers, msg.u.servers, sizeof(ntp_msg.u.servers) - 1);
+            if (not _ntp->post(ntp_msg))
+                ESP_LOGE(TAG, "Could not pass server list");
+            break;
+        }
+        case TIMER_SET_RADIO:
+        {
+            net_set_duty_cycle(msg.u.radio.duty_cycle, msg.u.radio.window_s * 1000);
+            break;
+        }
+        case TIMER_SET_SOURCE:
+        {
+            if (not timesource_set_priority(static_cast<time_source_t>(msg.u.source.id), msg.u.source.priority))
+                ESP_LOGE(TAG, "Could not set priority of source %u", msg.u.source.id);
+            break;
+        }
+        case TIMER_SET_ALARM:
+        {
+            if (not _alarms.set(msg.u.alarm.id, msg.u.alarm.rule, time(nullptr)))
+                ESP_LOGE(TAG, "Could not set alarm %u", msg.u.alarm.id);
+            break;
+        }
+        case TIMER_SNOOZE:
+        {
+            if (m_alarms_ready and not _alarms.snooze(time(nullptr), msg.u.snooze_min ? msg.u.snooze_min : ALARM_SNOOZE_MIN))
+                ESP_LOGD(TAG, "No alarm to snooze");
+            break;
+        }
+        case TIMER_DISMISS:
+        {
+            _alarms.dismiss();
+            break;
+        }
+        case TIMER_SET_TIME:
+        case TIMER_EVENT_SIZE:
+            break;
     }
-    ESP_ERROR_CHECK(ret);
-
-    wifi_init_sta();
-    sync_system_time();
-
-    now = {
-        .hour = 0,
-        .min  = 0,
-        .sec  = 0,
-    };
 }
 
 void Timer::run() noexcept
 {
+    const int64_t tick_us = portTICK_PERIOD_MS * 1000;
+
     while (1)
     {
-        timer_msg_t msg;
-        if (m_queue.receive(&msg, 0))
+        int64_t now_us  = wall_time_us();
+        int64_t left_us = m_deadline_us - now_us;
+
+        // the clock went back without a sync notification
+        if (left_us > m_period_s * 1000000LL)
         {
-            switch (msg.event)
-            {
-                case TIMER_SYNC:
-                {
-                    sync_system_time();
-                    break;
-                }
-                case TIMER_EVENT_SIZE:
-                    break;
-            }
+            schedule();
+            continue;
         }
 
-        tm     timeinfo;
-        get_time(timeinfo);
+        time_t alarm = m_alarms_ready ? _alarms.next() : 0;
+        if (alarm and alarm * 1000000LL <= now_us)
+        {
+            _alarms.fire(static_cast<time_t>(now_us / 1000000), alarm_callback);
+            continue;
+        }
+
+        // sleep until the boundary or the earliest alarm, whichever comes first
+        int64_t wake_us = left_us;
+        if (alarm and alarm * 1000000LL - now_us < wake_us)
+            wake_us = alarm * 1000000LL - now_us;
 
-        if (now != timeinfo)
+        if (wake_us > 0)
         {
-            now.hour = timeinfo.tm_hour;
-            now.min  = timeinfo.tm_min;
-            for (auto& el: callbacks)
-            {
-                if (el.first == TIMER_SET_TIME)
-                {
-                    el.second(timeinfo);
-                }
-            }
+            // a tick wait ends anywhere in its last tick, wait one more to never land before the boundary
+            uint32_t wait_ms = static_cast<uint32_t>((wake_us / tick_us + 1) * portTICK_PERIOD_MS);
+            timer_msg_t msg;
+            bool received = m_queue.receive(&msg, wait_ms);
+            m_wakeups++;
+            if (received)
+                handle(msg);
+            continue;
         }
 
-#ifdef PRINT_TIME
-        char strftime_buf[64];
-        strftime(strftime_buf, sizeof(strftime_buf), "%c", &timeinfo);
-        ESP_LOGI(TAG, "The current date/time in Lviv is: %s", strftime_buf);
-#endif
-        vTaskDelay(pdMS_TO_TICKS(500));
+        on_boundary(-left_us);
+        discipline_tick();
+        dispatch();
+        holdover_save();
+        // the boundary is a whole second, the RTC restarts its second on the write
+        if (m_rtc_dirty)
+            m_rtc_dirty = not rtc_source_save();
+        schedule();
     }
 }
 
@@ -305,13 +365,35 @@ void Timer::teardown() noexcept
 }
 
 
-void timer_init(const OSAL::Task::init_t& timer_init)
+void timer_init(const OSAL::Task::init_t& timer_init, const OSAL::Task::init_t& ntp_init,
+                const OSAL::Task::init_t& gps_init)
 {
     static std::aligned_storage_t<sizeof(Timer), alignof(Timer)> _task_rx_storage;
+    static std::aligned_storage_t<sizeof(Ntp), alignof(Ntp)> _ntp_storage;
+    static std::aligned_storage_t<sizeof(Gps), alignof(Gps)> _gps_storage;
+
+    // both tasks read their settings from NVS right away
+    esp_err_t err = nvs_flash_init();
+    if (err == ESP_ERR_NVS_NO_FREE_PAGES or err == ESP_ERR_NVS_NEW_VERSION_FOUND)
+    {
+        ESP_ERROR_CHECK(nvs_flash_erase());
+        err = nvs_flash_init();
+    }
+    ESP_ERROR_CHECK(err);
+
+    assert(not _ntp);
+    _ntp = new(&_ntp_storage) Ntp{on_sample};
+    bool ret = _ntp->start(ntp_init);
+    assert(ret);
+
+    assert(not _gps);
+    _gps = new(&_gps_storage) Gps{on_sample};
+    ret = _gps->start(gps_init);
+    assert(ret);
 
     assert(not _task_timer);
     _task_timer = new(&_task_rx_storage) Timer{};
-    bool ret = _task_timer->start(timer_init);
+    ret = _task_timer->start(timer_init);
     assert(ret);
 }
 
@@ -334,6 +416,11 @@ bool timer_register_cb(timer_event_t on_event, timer_cb_t func)
     return true;
 }
 
+void timer_register_alarm_cb(alarm_cb_t func)
+{
+    alarm_callback = func;
+}
+
 void timer_cb(timer_msg_t* msg)
 {
 
@@ -0,0 +1,204 @@
+#include "esp_log.h"
+#include "nvs.h"
+
+#include "alarm.h"
+
+static const char *TAG = "ALARM";
+
+static const char *NVS_NAMESPACE = "timer";
+static const char *NVS_KEY       = "alarms";
+
+time_t Alarms::next_after(const alarm_t& alarm, time_t after) noexcept
+{
+    tm local;
+    localtime_r(&after, &local);
+
+    // a weekday rule repeats within a week, a one-off rings within a day
+    for (int day = 0; day <= 7; day++)
+    {
+        tm candidate {};
+        candidate.tm_year  = local.tm_year;
+        candidate.tm_mon   = local.tm_mon;
+        candidate.tm_mday  = local.tm_mday + day;
+        candidate.tm_hour  = alarm.hour;
+        candidate.tm_min   = alarm.min;
+        candidate.tm_isdst = -1;
+
+        time_t at = mktime(&candidate);
+        if (at > after and (not alarm.days or alarm.days & 1 << candidate.tm_wday))
+            return at;
+    }
+    return 0;
+}
+
+void Alarms::push(const entry_t& entry) noexcept
+{
+    size_t pos = m_len++;
+    for (; pos and m_heap[(pos - 1) / 2].at > entry.at; pos = (pos - 1) / 2)
+        m_heap[pos] = m_heap[(pos - 1) / 2];
+    m_heap[pos] = entry;
+}
+
+void Alarms::pop() noexcept
+{
+    entry_t last = m_heap[--m_len];
+    size_t pos = 0;
+    for (size_t child = 1; child < m_len; pos = child, child = 2 * pos + 1)
+    {
+        if (child + 1 < m_len and m_heap[child + 1].at < m_heap[child].at)
+            child++;
+        if (m_heap[child].at >= last.at)
+            break;
+        m_heap[pos] = m_heap[child];
+    }
+    if (m_len)
+        m_heap[pos] = last;
+}
+
+void Alarms::erase(uint8_t id, bool snooze_only) noexcept
+{
+    // edits are rare and the heap is tiny, rebuild it without the alarm
+    size_t len = m_len;
+    entry_t kept[ALARM_MAX * 2];
+    size_t num = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (m_heap[i].id != id or (snooze_only and not m_heap[i].snooze))
+            kept[num++] = m_heap[i];
+    }
+    m_len = 0;
+    for (size_t i = 0; i < num; i++)
+        push(kept[i]);
+}
+
+void Alarms::rebuild(time_t now) noexcept
+{
+    m_len = 0;
+    for (uint8_t id = 0; id < ALARM_MAX; id++)
+    {
+        if (not m_alarms[id].enabled)
+            continue;
+        time_t at = next_after(m_alarms[id], now);
+        if (at)
+            push({at, id, false});
+    }
+}
+
+bool Alarms::load() noexcept
+{
+    nvs_handle_t handle;
+    if (ESP_OK != nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle))
+        return false;
+
+    size_t size = sizeof(m_alarms);
+    esp_err_t ret = nvs_get_blob(handle, NVS_KEY, m_alarms, &size);
+    nvs_close(handle);
+
+    if (ret != ESP_OK or size != sizeof(m_alarms))
+    {
+        for (auto& alarm: m_alarms)
+            alarm = {};
+        return false;
+    }
+    return true;
+}
+
+bool Alarms::save() const noexcept
+{
+    nvs_handle_t handle;
+    if (ESP_OK != nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle))
+    {
+        ESP_LOGE(TAG, "Could not open NVS");
+        return false;
+    }
+
+    esp_err_t ret = nvs_set_blob(handle, NVS_KEY, m_alarms, sizeof(m_alarms));
+    if (ret == ESP_OK)
+        ret = nvs_commit(handle);
+    nvs_close(handle);
+
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Could not store alarms");
+        return false;
+    }
+    return true;
+}
+
+bool Alarms::set(uint8_t id, const alarm_t& alarm, time_t now) noexcept
+{
+    if (id >= ALARM_MAX or alarm.hour > 23 or alarm.min > 59 or alarm.days > 0x7F)
+        return false;
+
+    m_alarms[id] = alarm;
+    erase(id);
+    if (alarm.enabled)
+    {
+        time_t at = next_after(alarm, now);
+        if (at)
+            push({at, id, false});
+    }
+    return save();
+}
+
+bool Alarms::snooze(time_t now, uint8_t min) noexcept
+{
+    if (m_ringing >= ALARM_MAX or now > m_ring_until)
+    {
+        m_ringing = ALARM_MAX;
+        return false;
+    }
+
+    // a second snooze replaces the first one
+    erase(m_ringing, true);
+    push({now + min * 60, m_ringing, true});
+    m_ringing = ALARM_MAX;
+    return true;
+}
+
+size_t Alarms::fire(time_t now, alarm_cb_t cb) noexcept
+{
+    size_t fired = 0;
+    bool   changed = false;
+    while (m_len and m_heap[0].at <= now)
+    {
+        entry_t entry = m_heap[0];
+        pop();
+
+        const alarm_t& alarm = m_alarms[entry.id];
+        bool missed = now - entry.at > ALARM_LATE_S;
+        if (not entry.snooze)
+        {
+            if (alarm.days)
+            {
+                // step from the fire time, so a late wakeup never skips an occurrence
+                time_t at = next_after(alarm, missed ? now : entry.at);
+                if (at)
+                    push({at, entry.id, false});
+            }
+            else
+            {
+                m_alarms[entry.id].enabled = false;
+                changed = true;
+            }
+        }
+
+        // stepped far over it, the moment is gone
+        if (missed)
+        {
+            ESP_LOGW(TAG, "Alarm %u missed by %lld s", entry.id, (long long)(now - entry.at));
+            continue;
+        }
+
+        ESP_LOGI(TAG, "Alarm %u%s", entry.id, entry.snooze ? " (snoozed)" : "");
+        m_ringing    = entry.id;
+        m_ring_until = now + ALARM_RING_S;
+        fired++;
+        if (cb)
+            cb(entry.id, alarm.melody);
+    }
+
+    if (changed)
+        save();
+    return fired;
+}
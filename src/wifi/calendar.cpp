@@ -0,0 +1,118 @@
+#include <cstdlib>
+
+#include "esp_log.h"
+#include "esp_cpu.h"
+
+#include "calendar.h"
+
+static const char *TAG = "CALENDAR";
+
+extern "C" int setenv (const char *__string, const char *__value, int __overwrite);
+extern "C" void tzset();
+
+static bool is_leap(int year) noexcept
+{
+    return (year % 4 == 0 and year % 100 != 0) or year % 400 == 0;
+}
+
+static int month_days(int mon, int year) noexcept
+{
+    static const uint8_t days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return days[mon] + (mon == 1 and is_leap(year));
+}
+
+bool Calendar::set_tz(const char* tz) noexcept
+{
+    tz_rule_t rule;
+    if (not tz_parse(tz, rule))
+    {
+        ESP_LOGE(TAG, "Malformed timezone \"%s\"", tz);
+        return false;
+    }
+
+    // keep libc in line for anything else formatting local time
+    setenv("TZ", tz, 1);
+    tzset();
+
+    m_rule        = rule;
+    m_table_valid = false;
+    m_valid       = false;
+    return true;
+}
+
+void Calendar::reset(time_t now) noexcept
+{
+    if (not m_table_valid or now < m_table.from or now >= m_table.until)
+    {
+        tm utc;
+        gmtime_r(&now, &utc);
+        tz_compile(m_rule, utc.tm_year + 1900, m_table);
+        m_table_valid = true;
+        ESP_LOGI(TAG, "Compiled %u UTC offset changes from %d", (unsigned)m_table.len, utc.tm_year + 1900);
+    }
+
+    int32_t offset = m_table.offset;
+    bool    dst    = m_table.dst;
+    m_transition   = m_table.until;
+    for (size_t i = 0; i < m_table.len; i++)
+    {
+        const tz_transition_t& change = m_table.transitions[i];
+        if (change.at > now)
+        {
+            m_transition = change.at;
+            break;
+        }
+        offset = change.offset;
+        dst    = change.dst;
+    }
+
+    time_t local = now + offset;
+    gmtime_r(&local, &m_local);
+    m_local.tm_isdst = dst;
+    m_time  = now;
+    m_valid = true;
+    m_stats.resets++;
+}
+
+void Calendar::carry(uint32_t seconds) noexcept
+{
+    uint32_t sec = m_local.tm_sec + seconds;
+    uint32_t min = m_local.tm_min + sec / 60;
+    uint32_t hour = m_local.tm_hour + min / 60;
+    m_local.tm_sec  = sec % 60;
+    m_local.tm_min  = min % 60;
+    m_local.tm_hour = hour % 24;
+
+    for (uint32_t days = hour / 24; days; days--)
+    {
+        m_local.tm_wday = (m_local.tm_wday + 1) % 7;
+        m_local.tm_yday++;
+        if (++m_local.tm_mday <= month_days(m_local.tm_mon, m_local.tm_year + 1900))
+            continue;
+
+        m_local.tm_mday = 1;
+        if (++m_local.tm_mon < 12)
+            continue;
+
+        m_local.tm_mon  = 0;
+        m_local.tm_yday = 0;
+        m_local.tm_year++;
+    }
+}
+
+const tm& Calendar::advance(time_t now) noexcept
+{
+    uint32_t start = esp_cpu_get_cycle_count();
+
+    if (not m_valid or now < m_time or now - m_time > CALENDAR_MAX_STEP_S or now >= m_transition)
+        reset(now);
+    else
+    {
+        carry(static_cast<uint32_t>(now - m_time));
+        m_time = now;
+        m_stats.steps++;
+    }
+
+    m_stats.cycles += esp_cpu_get_cycle_count() - start;
+    return m_local;
+}
@@ -0,0 +1,129 @@
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+#include "esp_log.h"
+#include "esp_sleep.h"
+
+#include "console.h"
+#include "RTC_time.h"
+
+static const char *TAG = "CONSOLE";
+
+static Console* _console = nullptr;
+
+void Console::setup() noexcept
+{
+    // the log keeps writing straight to the FIFO, the driver only takes over reception
+    m_uart = ESP_OK == uart_driver_install(CONSOLE_UART_NUM, CONSOLE_RX_BUF, 0, 0, nullptr, 0);
+    if (not m_uart)
+    {
+        ESP_LOGE(TAG, "Could not set up UART");
+        return;
+    }
+
+    if (ESP_OK != uart_set_wakeup_threshold(CONSOLE_UART_NUM, CONSOLE_WAKE_EDGES)
+        or ESP_OK != esp_sleep_enable_uart_wakeup(CONSOLE_UART_NUM))
+        ESP_LOGW(TAG, "No UART wakeup, commands are lost in light sleep");
+
+    // fails with power management off, there is no light sleep to keep off then
+    if (ESP_OK != esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "console", &m_pm_lock))
+        m_pm_lock = nullptr;
+}
+
+void Console::execute(const char* line) noexcept
+{
+    timer_msg_t msg {
+        .event = TIMER_EVENT_SIZE,
+        .u = {},
+    };
+
+    if (not strncmp(line, "servers ", 8))
+    {
+        msg.event = TIMER_SET_SERVERS;
+        strncpy(msg.u.servers, line + 8, sizeof(msg.u.servers) - 1);
+    }
+    else if (not strcmp(line, "sync"))
+        msg.event = TIMER_SYNC;
+    else if (not strncmp(line, "tz ", 3))
+    {
+        msg.event = TIMER_SET_TZ;
+        strncpy(msg.u.tz, line + 3, sizeof(msg.u.tz) - 1);
+    }
+    else
+    {
+        ESP_LOGW(TAG, "Unknown command \"%s\"", line);
+        return;
+    }
+
+    ESP_LOGI(TAG, "> %s", line);
+    timer_cb(&msg);
+}
+
+void Console::run() noexcept
+{
+    char   line[CONSOLE_LINE_LEN];
+    size_t len = 0;
+    bool   overflow = false;
+    bool   awake = false;
+
+    while (m_uart)
+    {
+        uint8_t c;
+        int n = uart_read_bytes(CONSOLE_UART_NUM, &c, 1, awake ? pdMS_TO_TICKS(CONSOLE_AWAKE_MS) : portMAX_DELAY);
+        if (n <= 0)
+        {
+            // the sender went quiet, sleep again
+            if (awake and m_pm_lock)
+                esp_pm_lock_release(m_pm_lock);
+            awake = false;
+            continue;
+        }
+
+        // the rest of the line has to arrive awake
+        if (not awake and m_pm_lock)
+            esp_pm_lock_acquire(m_pm_lock);
+        awake = true;
+
+        if (c == '\r')
+            continue;
+        if (c != '\n')
+        {
+            overflow = overflow or len >= sizeof(line) - 1;
+            if (not overflow)
+                line[len++] = static_cast<char>(c);
+            continue;
+        }
+
+        line[len] = '\0';
+        if (overflow)
+            ESP_LOGW(TAG, "Line longer than %u bytes dropped", (unsigned)(sizeof(line) - 1));
+        else if (len)
+            execute(line);
+        len      = 0;
+        overflow = false;
+    }
+}
+
+void Console::teardown() noexcept
+{
+    if (m_uart)
+        uart_driver_delete(CONSOLE_UART_NUM);
+    m_uart = false;
+
+    if (m_pm_lock)
+    {
+        esp_pm_lock_delete(m_pm_lock);
+        m_pm_lock = nullptr;
+    }
+}
+
+void console_init(const OSAL::Task::init_t& init)
+{
+    static std::aligned_storage_t<sizeof(Console), alignof(Console)> _console_storage;
+
+    assert(not _console);
+    _console = new(&_console_storage) Console{};
+    bool ret = _console->start(init);
+    assert(ret);
+}
@@ -0,0 +1,124 @@
+#include <sys/time.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "discipline.h"
+
+static const char *TAG = "DISCIPLINE";
+
+static Discipline _discipline;
+static int64_t    _last_tick_us = 0;
+
+static int64_t abs64(int64_t value)
+{
+    return value < 0 ? -value : value;
+}
+
+bool Discipline::sample(int64_t offset_us, int64_t mono_us) noexcept
+{
+    m_stats.samples++;
+    m_stats.offset_us = offset_us;
+    bool step = abs64(offset_us) > DISCIPLINE_STEP_US;
+
+    int64_t interval_us  = mono_us - m_last_us;
+    int64_t residual_ppb = 0;
+    int64_t limit_ppb    = DISCIPLINE_MAX_PPM * 1000LL;
+    if (m_has_last and interval_us >= DISCIPLINE_MIN_INTERVAL * 1000000LL)
+    {
+        // whatever the pending slew doesn't cover has built up since the previous sync
+        residual_ppb = -(offset_us - m_phase_us) * 1000000000LL / interval_us;
+    }
+
+    // larger residuals are clock jumps, not drift
+    if (residual_ppb and abs64(residual_ppb) <= limit_ppb)
+    {
+        int64_t drift_ppb = m_drift_ppb + (m_has_drift ? residual_ppb / DISCIPLINE_GAIN : residual_ppb);
+        m_drift_ppb = static_cast<int32_t>(drift_ppb > limit_ppb ? limit_ppb : drift_ppb < -limit_ppb ? -limit_ppb : drift_ppb);
+        m_has_drift = true;
+    }
+    m_last_us  = mono_us;
+    m_has_last = true;
+
+    if (step)
+    {
+        m_stats.steps++;
+        m_phase_us = 0;
+        return true;
+    }
+    m_phase_us = offset_us;
+    return false;
+}
+
+int64_t Discipline::tick(int64_t elapsed_us) noexcept
+{
+    m_frac -= static_cast<int64_t>(m_drift_ppb) * elapsed_us;
+    int64_t freq_us = m_frac / 1000000000LL;
+    m_frac -= freq_us * 1000000000LL;
+
+    int64_t phase_us = m_phase_us / DISCIPLINE_PHASE_TICKS;
+    if (not phase_us)
+        phase_us = m_phase_us;
+    m_phase_us -= phase_us;
+
+    m_stats.slewed_us += freq_us + phase_us;
+    return freq_us + phase_us;
+}
+
+void discipline_init(int32_t drift_ppb) noexcept
+{
+    _discipline   = Discipline{drift_ppb};
+    _last_tick_us = esp_timer_get_time();
+}
+
+void discipline_offset(int64_t offset_us) noexcept
+{
+    if (_discipline.sample(offset_us, esp_timer_get_time()))
+    {
+        // cancel a slew in progress, it was computed for the old time
+        const timeval zero {};
+        adjtime(&zero, nullptr);
+
+        timeval now;
+        gettimeofday(&now, nullptr);
+        int64_t us = static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_usec + offset_us;
+        const timeval ref {
+            .tv_sec  = static_cast<time_t>(us / 1000000),
+            .tv_usec = static_cast<suseconds_t>(us % 1000000),
+        };
+        settimeofday(&ref, nullptr);
+    }
+    ESP_LOGI(TAG, "Offset %lld us, drift %ld ppb", (long long)offset_us, (long)_discipline.drift_ppb());
+}
+
+void discipline_tick() noexcept
+{
+    int64_t now_us     = esp_timer_get_time();
+    int64_t elapsed_us = now_us - _last_tick_us;
+    _last_tick_us = now_us;
+
+    int64_t correction_us = _discipline.tick(elapsed_us);
+    if (not correction_us)
+        return;
+
+    // a new adjtime replaces the running one, carry over what it hasn't slewed yet
+    timeval left {};
+    adjtime(nullptr, &left);
+    correction_us += static_cast<int64_t>(left.tv_sec) * 1000000 + left.tv_usec;
+
+    const timeval delta {
+        .tv_sec  = static_cast<time_t>(correction_us / 1000000),
+        .tv_usec = static_cast<suseconds_t>(correction_us % 1000000),
+    };
+    adjtime(&delta, nullptr);
+}
+
+int32_t discipline_drift_ppb() noexcept
+{
+    return _discipline.drift_ppb();
+}
+
+const discipline_stats_t& discipline_get_stats() noexcept
+{
+    return _discipline.get_stats();
+}
@@ -0,0 +1,185 @@
+#include <sys/time.h>
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "gps.h"
+#include "timesource.h"
+
+static const char *TAG = "GPS";
+
+static portMUX_TYPE _pps_lock  = portMUX_INITIALIZER_UNLOCKED;
+static int64_t      _pps_us    = 0;  ///< monotonic time of the last PPS edge
+static uint32_t     _pps_count = 0;
+
+static int64_t wall_time_us()
+{
+    timeval tv;
+    gettimeofday(&tv, nullptr);
+    return static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+void Gps::pps_isr(void*)
+{
+    int64_t now_us = esp_timer_get_time();
+
+    portENTER_CRITICAL_ISR(&_pps_lock);
+    _pps_us = now_us;
+    _pps_count++;
+    portEXIT_CRITICAL_ISR(&_pps_lock);
+}
+
+void Gps::on_fix(int64_t mono_us) noexcept
+{
+    const nmea_fix_t& fix = m_nmea.fix();
+    if (not fix.valid)
+        return;
+    m_stats.fixes++;
+
+    portENTER_CRITICAL(&_pps_lock);
+    int64_t pps_us = _pps_us;
+    m_stats.pps    = _pps_count;
+    portEXIT_CRITICAL(&_pps_lock);
+
+    // monotonic time of the second the sentence names
+    int64_t at_us, uncertainty_us;
+    if (pps_us and fix.utc_us == 0 and mono_us - pps_us < GPS_PPS_WINDOW_US)
+    {
+        at_us          = pps_us;
+        uncertainty_us = GPS_PPS_US;
+        m_stats.aligned++;
+    }
+    else
+    {
+        at_us          = mono_us - GPS_NMEA_DELAY_US;
+        uncertainty_us = GPS_NMEA_US;
+    }
+
+    if (m_offered_us and mono_us - m_offered_us < GPS_INTERVAL_S * 1000000LL)
+        return;
+    m_offered_us = mono_us;
+    m_stats.offers++;
+
+    int64_t ref_us  = fix.utc * 1000000LL + fix.utc_us;
+    int64_t wall_us = wall_time_us() - (esp_timer_get_time() - at_us);
+    m_stats.offset_us = ref_us - wall_us;
+    ESP_LOGI(TAG, "Offset %lld us, %s", (long long)m_stats.offset_us, uncertainty_us == GPS_PPS_US ? "PPS aligned" : "no PPS");
+    if (m_on_sample)
+        m_on_sample(TIME_SOURCE_GPS, m_stats.offset_us, static_cast<uint32_t>(uncertainty_us));
+}
+
+void Gps::log_stats() const noexcept
+{
+    if (not m_stats.present)
+    {
+        ESP_LOGI(TAG, "No receiver");
+        return;
+    }
+
+    const nmea_stats_t& nmea = m_nmea.get_stats();
+    // taken samples are counted by the source selection, in the timer task calling this
+    ESP_LOGI(TAG, "%lu fixes, %lu PPS edges, %lu aligned; %lu of %lu samples taken, last offset %lld us",
+             (unsigned long)m_stats.fixes, (unsigned long)m_stats.pps, (unsigned long)m_stats.aligned,
+             (unsigned long)timesource_get_stats().taken[TIME_SOURCE_GPS], (unsigned long)m_stats.offers,
+             (long long)m_stats.offset_us);
+    ESP_LOGI(TAG, "Parser: %lu bytes, %lu sentences, %lu fixes, %lu errors",
+             (unsigned long)nmea.bytes, (unsigned long)nmea.sentences, (unsigned long)nmea.fixes,
+             (unsigned long)nmea.errors);
+}
+
+void Gps::setup() noexcept
+{
+    // fails with power management off, there is no light sleep to keep off then
+    if (ESP_OK == esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "gps", &m_pm_lock))
+        esp_pm_lock_acquire(m_pm_lock);
+    else
+        m_pm_lock = nullptr;
+
+    const uart_config_t config {
+        .baud_rate           = GPS_BAUD,
+        .data_bits           = UART_DATA_8_BITS,
+        .parity              = UART_PARITY_DISABLE,
+        .stop_bits           = UART_STOP_BITS_1,
+        .flow_ctrl           = UART_HW_FLOWCTRL_DISABLE,
+        .rx_flow_ctrl_thresh = 0,
+        .source_clk          = UART_SCLK_DEFAULT,
+    };
+    m_uart = ESP_OK == uart_driver_install(GPS_UART_NUM, GPS_RX_BUF, 0, 0, nullptr, 0);
+    if (not m_uart
+        or ESP_OK != uart_param_config(GPS_UART_NUM, &config)
+        or ESP_OK != uart_set_pin(GPS_UART_NUM, UART_PIN_NO_CHANGE, GPS_RX_IO, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE))
+    {
+        ESP_LOGE(TAG, "Could not set up UART");
+        return;
+    }
+
+    gpio_set_direction(GPS_PPS_IO, GPIO_MODE_INPUT);
+    gpio_set_pull_mode(GPS_PPS_IO, GPIO_PULLDOWN_ONLY);
+    gpio_set_intr_type(GPS_PPS_IO, GPIO_INTR_POSEDGE);
+    esp_err_t ret = gpio_install_isr_service(0);
+    if ((ret != ESP_OK and ret != ESP_ERR_INVALID_STATE) or ESP_OK != gpio_isr_handler_add(GPS_PPS_IO, pps_isr, this))
+        ESP_LOGW(TAG, "Could not attach PPS, NMEA time only");
+    else
+        gpio_intr_enable(GPS_PPS_IO);
+}
+
+void Gps::run() noexcept
+{
+    const int64_t start_us = esp_timer_get_time();
+    bool silent = false;
+
+    while (m_uart)
+    {
+        uint8_t chunk[GPS_CHUNK];
+        int len = uart_read_bytes(GPS_UART_NUM, chunk, sizeof(chunk), pdMS_TO_TICKS(20));
+        int64_t now_us = esp_timer_get_time();
+
+        if (len > 0)
+        {
+            uint32_t sentences = m_nmea.get_stats().sentences;
+            std::span<const uint8_t> data {chunk, static_cast<size_t>(len)};
+            while (not data.empty())
+            {
+                bool ready;
+                data = data.subspan(m_nmea.parse(data, ready));
+                if (ready)
+                    on_fix(now_us);
+            }
+
+            if (sentences != m_nmea.get_stats().sentences)
+            {
+                if (not m_stats.present or silent)
+                    ESP_LOGI(TAG, "Receiver is talking");
+                m_stats.present = true;
+                m_heard_us      = now_us;
+                silent          = false;
+            }
+        }
+
+        if (not m_stats.present and now_us - start_us > GPS_PROBE_MS * 1000LL)
+        {
+            ESP_LOGI(TAG, "No receiver, GPS time source off");
+            break;
+        }
+        if (m_stats.present and not silent and now_us - m_heard_us > GPS_SILENT_MS * 1000LL)
+        {
+            ESP_LOGW(TAG, "Receiver went silent");
+            silent = true;
+        }
+    }
+}
+
+void Gps::teardown() noexcept
+{
+    gpio_isr_handler_remove(GPS_PPS_IO);
+    if (m_uart)
+        uart_driver_delete(GPS_UART_NUM);
+    m_uart = false;
+
+    if (m_pm_lock)
+    {
+        esp_pm_lock_release(m_pm_lock);
+        esp_pm_lock_delete(m_pm_lock);
+        m_pm_lock = nullptr;
+    }
+}
@@ -0,0 +1,192 @@
+#include <cstddef>
+#include <type_traits>
+#include <sys/time.h>
+
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_idf_version.h"
+#include "esp_private/esp_clk.h"
+#include "nvs.h"
+
+#include "holdover.h"
+
+// esp_clk_rtc_time() has no public counterpart, the private header may change with any release
+#if ESP_IDF_VERSION < ESP_IDF_VERSION_VAL(5, 1, 0) or ESP_IDF_VERSION >= ESP_IDF_VERSION_VAL(5, 2, 0)
+#error "holdover.cpp relies on esp_private/esp_clk.h of ESP-IDF 5.1, check esp_clk_rtc_time() and update the range"
+#endif
+
+// the checksum hashes raw bytes, padding would be whatever the stack or RTC memory held
+static_assert(std::has_unique_object_representations_v<holdover_t>, "holdover_t has padding");
+
+static const char *TAG = "HOLDOVER";
+
+static const char *NVS_NAMESPACE = "timer";
+static const char *NVS_KEY       = "holdover";
+
+#define HOLDOVER_MAGIC      0x484F4C44  ///< "HOLD"
+#define HOLDOVER_VALID_TIME 1451606400  ///< 2016-01-01, earlier time was never set
+
+static RTC_NOINIT_ATTR holdover_t _rtc;  ///< survives software and watchdog resets
+
+static holdover_t _state = {};
+static bool       _valid = false;    ///< @ref _state holds a real time
+static bool       _bounded = false;  ///< time since the last sync is known
+static int64_t    _nvs_saved_us = 0;
+
+static int64_t wall_time_us()
+{
+    timeval tv;
+    gettimeofday(&tv, nullptr);
+    return static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+static void set_wall_time_us(int64_t us)
+{
+    timeval tv {
+        .tv_sec  = static_cast<time_t>(us / 1000000),
+        .tv_usec = static_cast<suseconds_t>(us % 1000000),
+    };
+    settimeofday(&tv, nullptr);
+}
+
+/**
+ * @brief FNV-1a of everything but the crc itself
+ */
+static uint32_t checksum(const holdover_t& state)
+{
+    const auto* bytes = reinterpret_cast<const uint8_t*>(&state);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(holdover_t, crc); i++)
+        hash = (hash ^ bytes[i]) * 16777619u;
+    return hash;
+}
+
+static bool check(const holdover_t& state)
+{
+    return state.magic == HOLDOVER_MAGIC and state.crc == checksum(state) and state.saved_us >= HOLDOVER_VALID_TIME * 1000000LL;
+}
+
+static bool nvs_load(holdover_t& state)
+{
+    nvs_handle_t handle;
+    if (ESP_OK != nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle))
+        return false;
+
+    size_t size = sizeof(state);
+    esp_err_t ret = nvs_get_blob(handle, NVS_KEY, &state, &size);
+    nvs_close(handle);
+    return ret == ESP_OK and size == sizeof(state) and check(state);
+}
+
+static void nvs_save(const holdover_t& state)
+{
+    nvs_handle_t handle;
+    if (ESP_OK != nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle))
+    {
+        ESP_LOGE(TAG, "Could not open NVS");
+        return;
+    }
+
+    esp_err_t ret = nvs_set_blob(handle, NVS_KEY, &state, sizeof(state));
+    if (ret == ESP_OK)
+        ret = nvs_commit(handle);
+    nvs_close(handle);
+
+    if (ret != ESP_OK)
+        ESP_LOGE(TAG, "Could not store holdover");
+    _nvs_saved_us = state.saved_us;
+}
+
+static int64_t uncertainty_us(int64_t now_us)
+{
+    int64_t age_us = now_us > _state.synced_us ? now_us - _state.synced_us : 0;
+    return _state.uncertainty_us + age_us / 1000000 * HOLDOVER_DRIFT_UNCERTAINTY;
+}
+
+holdover_restore_t holdover_restore() noexcept
+{
+    int64_t  now_us = wall_time_us();
+    uint64_t rtc_us = esp_clk_rtc_time();
+    holdover_restore_t ret {HOLDOVER_NONE, -1};
+
+    if (check(_rtc))
+    {
+        _state   = _rtc;
+        _valid   = true;
+        _bounded = true;
+
+        if (now_us >= HOLDOVER_VALID_TIME * 1000000LL)
+            ret.source = HOLDOVER_SYSTEM;
+        else if (rtc_us >= _state.saved_rtc_us)
+        {
+            // RTC counter kept running through the reset, correct the elapsed time by the known drift
+            int64_t elapsed_us = rtc_us - _state.saved_rtc_us;
+            now_us = _state.saved_us + elapsed_us - elapsed_us / 1000 * _state.drift_ppb / 1000000;
+            set_wall_time_us(now_us);
+            ret.source = HOLDOVER_RTC;
+        }
+        else
+            _valid = false;
+    }
+
+    if (not _valid and nvs_load(_state))
+    {
+        // powered off for an unknown time, stale time still beats 1970 until the first sync
+        _valid   = true;
+        _bounded = false;
+        if (now_us < HOLDOVER_VALID_TIME * 1000000LL)
+        {
+            now_us = _state.saved_us;
+            set_wall_time_us(now_us);
+        }
+        ret.source = HOLDOVER_NVS;
+    }
+
+    if (ret.source != HOLDOVER_NONE)
+        _nvs_saved_us = _state.saved_us;
+    ret.uncertainty_ms = holdover_uncertainty_ms();
+
+    static const char* names[] = {"none", "system clock", "RTC memory", "NVS"};
+    ESP_LOGI(TAG, "Clock restored from %s, uncertainty %lld ms", names[ret.source], (long long)ret.uncertainty_ms);
+    return ret;
+}
+
+void holdover_synced(uint32_t uncertainty, int32_t drift_ppb) noexcept
+{
+    _state.magic          = HOLDOVER_MAGIC;
+    _state.synced_us      = wall_time_us();
+    _state.uncertainty_us = uncertainty;
+    _state.drift_ppb      = drift_ppb;
+    _valid   = true;
+    _bounded = true;
+
+    // a sync is worth a flash write right away
+    _nvs_saved_us = 0;
+    holdover_save();
+}
+
+void holdover_save() noexcept
+{
+    if (not _valid)
+        return;
+
+    _state.saved_us     = wall_time_us();
+    _state.saved_rtc_us = esp_clk_rtc_time();
+    _state.crc          = checksum(_state);
+    _rtc = _state;
+
+    if (_state.saved_us - _nvs_saved_us >= HOLDOVER_NVS_PERIOD_S * 1000000LL)
+        nvs_save(_state);
+}
+
+int64_t holdover_uncertainty_ms() noexcept
+{
+    if (not _valid or not _bounded)
+        return -1;
+    return uncertainty_us(wall_time_us()) / 1000;
+}
+
+int32_t holdover_drift_ppb() noexcept
+{
+    return _valid ? _state.drift_ppb : 0;
+}
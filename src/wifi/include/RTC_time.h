@@ -1,11 +1,25 @@
 #ifndef EXPERIMENTS_RTC_TIME_H
 #define EXPERIMENTS_RTC_TIME_H
 
+#include <ctime>
+
 #include "osal.h"
-#include "esp_sntp.h"
+#include "tz.h"
+#include "ntp.h"
+#include "gps.h"
+#include "alarm.h"
 
 enum timer_event_t {
     TIMER_SYNC,
+    TIMER_SAMPLE,
+    TIMER_SET_PERIOD,
+    TIMER_SET_TZ,
+    TIMER_SET_SERVERS,
+    TIMER_SET_RADIO,
+    TIMER_SET_SOURCE,
+    TIMER_SET_ALARM,
+    TIMER_SNOOZE,
+    TIMER_DISMISS,
     TIMER_SET_TIME,
 
     TIMER_EVENT_SIZE
@@ -15,7 +29,28 @@ struct timer_msg_t {
     timer_event_t event;
 
     union {
-        uint8_t nothing;
+        uint8_t  nothing;
+        struct {
+            uint8_t  source;          ///< time_source_t
+            uint32_t uncertainty_us;  ///< how far the offset can be off
+            int64_t  offset_us;       ///< reference minus clock time
+        } sample;                 ///< TIMER_SAMPLE: corrects the clock if the source is selected
+        uint8_t  period_s;  ///< TIMER_SET_PERIOD: 1 - every second, 60 - every minute
+        char    tz[TZ_MAX_LEN];  ///< TIMER_SET_TZ: POSIX TZ string, stored in NVS
+        char    servers[NTP_SERVERS_LEN];  ///< TIMER_SET_SERVERS: "host[:port],...", stored in NVS
+        struct {
+            uint8_t  duty_cycle;  ///< 0 - radio always on in modem sleep
+            uint16_t window_s;    ///< radio window for a sync
+        } radio;                  ///< TIMER_SET_RADIO
+        struct {
+            uint8_t id;           ///< time_source_t
+            uint8_t priority;     ///< higher wins, 0 - ignored
+        } source;                 ///< TIMER_SET_SOURCE: stored in NVS
+        struct {
+            uint8_t id;           ///< slot, 0 .. ALARM_MAX - 1
+            alarm_t rule;         ///< disabled rule removes the alarm
+        } alarm;                  ///< TIMER_SET_ALARM: stored in NVS
+        uint8_t snooze_min;       ///< TIMER_SNOOZE: 0 - default, ignored unless an alarm rings
     } u;
 };
 
@@ -32,8 +67,11 @@ typedef void(*timer_cb_t)(tm& timeinfo);
  * @brief init timer tasks
  *
  * @param [in] timer_init Rx task options
+ * @param [in] ntp_init   NTP client task options
+ * @param [in] gps_init   GPS receiver task options
  */
-void timer_init(const OSAL::Task::init_t& timer_init);
+void timer_init(const OSAL::Task::init_t& timer_init, const OSAL::Task::init_t& ntp_init,
+                const OSAL::Task::init_t& gps_init);
 
 /**
  * @brief deinit timer tasks
@@ -51,6 +89,13 @@ bool timer_deinit();
  */
 bool timer_register_cb(timer_event_t on_event, timer_cb_t func);
 
+/**
+ * @brief register callback for alarms
+ *
+ * @param [in] func callback function, called from the timer task
+ */
+void timer_register_alarm_cb(alarm_cb_t func);
+
 /**
  * @brief timer callback
  *
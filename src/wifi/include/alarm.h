@@ -0,0 +1,119 @@
+#ifndef EXPERIMENTS_ALARM_H
+#define EXPERIMENTS_ALARM_H
+
+#include <cstdint>
+#include <cstddef>
+#include <ctime>
+
+#define ALARM_MAX        8    ///< alarm slots
+#define ALARM_SNOOZE_MIN 9    ///< default snooze
+#define ALARM_LATE_S     120  ///< an alarm the clock stepped over still rings if this recent
+#define ALARM_RING_S     120  ///< a ring nobody stopped ends after this, as the buzzer gives up
+
+/**
+ * @brief alarm rule, local time
+ */
+struct alarm_t {
+    uint8_t hour;
+    uint8_t min;
+    uint8_t days;     ///< weekdays to ring, bit 0 - Sunday; 0 - ring once at the next hour:min
+    uint8_t melody;   ///< passed to the buzzer
+    bool    enabled;
+};
+
+/**
+ * @brief alarm callback function
+ *
+ * Called from the timer task when an alarm or its snooze is due
+ *
+ * @param [in] id     alarm slot
+ * @param [in] melody melody of the alarm
+ */
+typedef void(*alarm_cb_t)(uint8_t id, uint8_t melody);
+
+/**
+ * @class Alarms
+ * @brief alarm rules and their next fire times
+ *
+ * Next fire times of enabled alarms and pending snoozes are kept in a min-heap, so the earliest one
+ * is known without a scan. When an alarm fires only its own next occurrence is computed, from the
+ * fire time. Fire times are UTC and stay valid across a clock step, a late one still rings within
+ * @ref ALARM_LATE_S. Everything is recomputed only when the timezone changes or the clock first gets valid.
+ */
+class Alarms
+{
+private:
+    struct entry_t {
+        time_t  at;      ///< UTC fire time
+        uint8_t id;
+        bool    snooze;
+    };
+
+    alarm_t m_alarms[ALARM_MAX] = {};
+    entry_t m_heap[ALARM_MAX * 2];   ///< an alarm and its snooze at most
+    size_t  m_len = 0;
+    uint8_t m_ringing = ALARM_MAX;   ///< alarm ringing now, target of snooze
+    time_t  m_ring_until = 0;        ///< the ring ends by itself
+
+    static time_t next_after(const alarm_t& alarm, time_t after) noexcept;
+    void push(const entry_t& entry) noexcept;
+    void pop() noexcept;
+    void erase(uint8_t id, bool snooze_only = false) noexcept;
+    bool save() const noexcept;
+
+public:
+    /**
+     * @brief restore rules from NVS, @ref rebuild schedules them once the clock is valid
+     */
+    bool load() noexcept;
+
+    /**
+     * @brief recompute every fire time, after the clock got valid or timezone changed
+     *
+     * Pending snoozes are dropped
+     *
+     * @param [in] now current UTC time
+     */
+    void rebuild(time_t now) noexcept;
+
+    /**
+     * @brief replace alarm rule and store it
+     *
+     * @param [in] id    slot
+     * @param [in] alarm rule
+     * @param [in] now   current UTC time
+     */
+    bool set(uint8_t id, const alarm_t& alarm, time_t now) noexcept;
+
+    /**
+     * @brief ring the ringing alarm again later, ends the ring
+     *
+     * @param [in] now current UTC time
+     * @param [in] min minutes to snooze
+     *
+     * @retval true  snoozed
+     * @retval false nothing rings, nothing to snooze
+     */
+    bool snooze(time_t now, uint8_t min = ALARM_SNOOZE_MIN) noexcept;
+
+    void dismiss() noexcept { m_ringing = ALARM_MAX; }  ///< @brief ring was stopped, it can't be snoozed anymore
+
+    /**
+     * @brief earliest fire time, 0 - nothing scheduled
+     */
+    time_t next() const noexcept { return m_len ? m_heap[0].at : 0; }
+
+    /**
+     * @brief fire due alarms and schedule their next occurrence
+     *
+     * @param [in] now current UTC time
+     * @param [in] cb  called for every alarm ringing
+     *
+     * @return alarms fired
+     */
+    size_t fire(time_t now, alarm_cb_t cb) noexcept;
+
+    const alarm_t& get(uint8_t id) const noexcept { return m_alarms[id]; }
+};
+
+#endif //EXPERIMENTS_ALARM_H
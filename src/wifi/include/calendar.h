@@ -0,0 +1,80 @@
+#ifndef EXPERIMENTS_CALENDAR_H
+#define EXPERIMENTS_CALENDAR_H
+
+#include <cstdint>
+#include <ctime>
+
+#include "tz.h"
+
+#define CALENDAR_MAX_STEP_S      86400          ///< larger jumps are converted from scratch
+
+/**
+ * @brief calendar engine statistics
+ */
+struct calendar_stats_t {
+    uint32_t steps;   ///< incremental advances
+    uint32_t resets;  ///< full conversions
+    uint64_t cycles;  ///< CPU cycles spent in @ref Calendar::advance
+};
+
+/**
+ * @class Calendar
+ * @brief cached local time
+ *
+ * The timezone rule is parsed once and compiled into a table of UTC offset changes. Between two
+ * changes local time is a fixed offset from UTC, so broken-down time is advanced with carry from
+ * the previous value. A full conversion only happens at a change, when the clock steps back or
+ * jumps too far.
+ */
+class Calendar
+{
+private:
+    tm               m_local = {};
+    time_t           m_time = 0;        ///< UTC time of @ref m_local
+    time_t           m_transition = 0;  ///< next UTC offset change
+    bool             m_valid = false;
+    calendar_stats_t m_stats = {};
+
+    tz_rule_t        m_rule = {};
+    tz_table_t       m_table = {};
+    bool             m_table_valid = false;
+
+    void reset(time_t now) noexcept;
+    void carry(uint32_t seconds) noexcept;
+
+public:
+    Calendar() noexcept = default;
+
+    /**
+     * @brief apply timezone
+     *
+     * @param [in] tz POSIX TZ string
+     *
+     * @retval true  timezone applied
+     * @retval false malformed string, previous timezone kept
+     */
+    bool set_tz(const char* tz) noexcept;
+
+    /**
+     * @brief abbreviation of the current zone, e.g. "EEST"
+     */
+    const char* zone() const noexcept { return m_local.tm_isdst > 0 ? m_rule.dst_name : m_rule.std_name; }
+
+    /**
+     * @brief local time at @p now
+     *
+     * @param [in] now UTC time
+     *
+     * @return broken-down local time
+     */
+    const tm& advance(time_t now) noexcept;
+
+    /**
+     * @brief next UTC offset change or end of the compiled table
+     */
+    time_t next_transition() const noexcept { return m_transition; }
+
+    const calendar_stats_t& get_stats() const noexcept { return m_stats; }
+};
+
+#endif //EXPERIMENTS_CALENDAR_H
@@ -0,0 +1,50 @@
+#ifndef EXPERIMENTS_CONSOLE_H
+#define EXPERIMENTS_CONSOLE_H
+
+#include <cstdint>
+
+#include "driver/uart.h"
+#include "esp_pm.h"
+
+#include "osal.h"
+#include "ntp.h"
+
+#define CONSOLE_UART_NUM   UART_NUM_0             ///< the log console
+#define CONSOLE_RX_BUF     256
+#define CONSOLE_LINE_LEN   (NTP_SERVERS_LEN + 16)
+#define CONSOLE_WAKE_EDGES 3                      ///< RX edges that wake the chip, those bytes are lost
+#define CONSOLE_AWAKE_MS   2000                   ///< light sleep stays off this long after the last byte
+
+/**
+ * @class Console
+ * @brief line commands on the log UART, for test harnesses
+ *
+ * `servers host[:port],...` sets the NTP servers, `sync` polls them right away, `tz <POSIX TZ>`
+ * sets the timezone; all of them are passed to the timer task. The UART stops in light sleep:
+ * the first bytes only wake the chip, send a newline and wait a moment before a command.
+ */
+class Console final : public OSAL::Task
+{
+private:
+    esp_pm_lock_handle_t m_pm_lock = nullptr;
+    bool                 m_uart = false;
+
+    void execute(const char* line) noexcept;
+
+public:
+    explicit Console() noexcept : OSAL::Task{} {}
+
+private:
+    void setup() noexcept final;
+    void run() noexcept final;
+    void teardown() noexcept final;
+};
+
+/**
+ * @brief start the console task
+ *
+ * @param [in] init task options
+ */
+void console_init(const OSAL::Task::init_t& init);
+
+#endif //EXPERIMENTS_CONSOLE_H
@@ -0,0 +1,94 @@
+#ifndef EXPERIMENTS_DISCIPLINE_H
+#define EXPERIMENTS_DISCIPLINE_H
+
+#include <cstdint>
+
+#define DISCIPLINE_STEP_US       128000  ///< larger offsets are stepped, smaller ones slewed
+#define DISCIPLINE_MIN_INTERVAL  60      ///< s, shorter sync intervals don't tell the drift
+#define DISCIPLINE_MAX_PPM       500     ///< drift estimate limit
+#define DISCIPLINE_GAIN          4       ///< drift filter takes 1/4 of every new estimate
+#define DISCIPLINE_PHASE_TICKS   8       ///< ticks a phase offset is slewed over
+
+/**
+ * @brief clock discipline statistics
+ */
+struct discipline_stats_t {
+    uint32_t samples;      ///< syncs seen
+    uint32_t steps;        ///< syncs that stepped the clock
+    int64_t  offset_us;    ///< last measured offset, positive - clock was behind
+    int64_t  slewed_us;    ///< total slew applied
+};
+
+/**
+ * @class Discipline
+ * @brief drift estimation and slew correction of the system clock
+ *
+ * Every sync gives the clock offset. The part of it not explained by the phase still waiting to
+ * be slewed is a frequency error over the sync interval and feeds an exponential drift filter.
+ * Between syncs every tick returns the correction undoing the estimated drift plus a share of the
+ * outstanding phase. The class does no I/O, the caller measures offsets and applies corrections.
+ */
+class Discipline
+{
+private:
+    int32_t            m_drift_ppb = 0;     ///< positive - clock runs fast
+    int64_t            m_phase_us = 0;      ///< offset left to slew
+    int64_t            m_frac = 0;          ///< drift correction below 1 us, in us * 1e9
+    int64_t            m_last_us = 0;       ///< monotonic time of the previous sample
+    bool               m_has_last = false;
+    bool               m_has_drift = false;
+    discipline_stats_t m_stats = {};
+
+public:
+    explicit Discipline(int32_t drift_ppb = 0) noexcept : m_drift_ppb{drift_ppb}, m_has_drift{drift_ppb != 0} {}
+
+    /**
+     * @brief feed a sync
+     *
+     * @param [in] offset_us reference minus clock time
+     * @param [in] mono_us   monotonic time of the measurement
+     *
+     * @retval true  offset is too large to slew, the caller steps the clock
+     * @retval false offset is slewed by the next ticks
+     */
+    bool sample(int64_t offset_us, int64_t mono_us) noexcept;
+
+    /**
+     * @brief correction for a tick
+     *
+     * @param [in] elapsed_us monotonic time since the previous tick
+     *
+     * @return microseconds to add to the clock
+     */
+    int64_t tick(int64_t elapsed_us) noexcept;
+
+    int32_t drift_ppb() const noexcept { return m_drift_ppb; }
+    const discipline_stats_t& get_stats() const noexcept { return m_stats; }
+};
+
+/**
+ * @brief start disciplining the system clock
+ *
+ * @param [in] drift_ppb drift known from a previous run
+ */
+void discipline_init(int32_t drift_ppb) noexcept;
+
+/**
+ * @brief correct the system clock by a measured offset, stepping or slewing it
+ *
+ * Not locked, call it from the task calling @ref discipline_tick
+ *
+ * @param [in] offset_us reference minus clock time
+ */
+void discipline_offset(int64_t offset_us) noexcept;
+
+/**
+ * @brief apply accumulated correction to the system clock, call periodically
+ */
+void discipline_tick() noexcept;
+
+int32_t discipline_drift_ppb() noexcept;
+
+const discipline_stats_t& discipline_get_stats() noexcept;
+
+#endif //EXPERIMENTS_DISCIPLINE_H
@@ -0,0 +1,82 @@
+#ifndef EXPERIMENTS_GPS_H
+#define EXPERIMENTS_GPS_H
+
+#include <cstdint>
+
+#include "driver/uart.h"
+#include "driver/gpio.h"
+#include "esp_pm.h"
+
+#include "osal.h"
+#include "nmea.h"
+#include "ntp.h"
+
+#define GPS_UART_NUM         UART_NUM_2
+#define GPS_RX_IO            GPIO_NUM_16
+#define GPS_PPS_IO           GPIO_NUM_4
+#define GPS_BAUD             9600
+#define GPS_RX_BUF           1024       ///< driver ring buffer, a second of output fits
+#define GPS_CHUNK            64         ///< bytes taken from the ring buffer at once
+#define GPS_PROBE_MS         5000       ///< receiver has to talk within this time after boot
+#define GPS_SILENT_MS        3000       ///< receiver is considered gone after this silence
+#define GPS_INTERVAL_S       64         ///< offers to the clock, shorter ones don't tell the drift
+#define GPS_PPS_WINDOW_US    1000000    ///< RMC names the second of a PPS edge at most this old
+#define GPS_PPS_US           100        ///< uncertainty of a PPS aligned time: interrupt latency
+#define GPS_NMEA_DELAY_US    250000     ///< typical RMC delay after the second it names, without PPS
+#define GPS_NMEA_US          250000     ///< uncertainty of a time taken from the sentence alone
+
+/**
+ * @brief GPS source statistics
+ */
+struct gps_stats_t {
+    bool     present;     ///< receiver talked within @ref GPS_PROBE_MS
+    uint32_t fixes;       ///< RMC times with a valid fix
+    uint32_t pps;         ///< PPS edges seen
+    uint32_t aligned;     ///< fixes paired with a PPS edge
+    uint32_t offers;      ///< samples offered to the clock
+    int64_t  offset_us;   ///< last measured offset, positive - clock was behind
+};
+
+/**
+ * @class Gps
+ * @brief NMEA time source with optional PPS alignment
+ *
+ * Receiver output is parsed in place, chunk by chunk, as the UART driver hands it over. A PPS edge
+ * is timestamped by its interrupt; the RMC sentence that follows names the second the edge started,
+ * which aligns the clock to the interrupt latency. Without PPS the sentence arrival is used.
+ * Samples are handed to the timer task every @ref GPS_INTERVAL_S. UART reception
+ * doesn't survive light sleep, so while a receiver is present light sleep is kept off; without one
+ * the task ends after @ref GPS_PROBE_MS.
+ */
+class Gps final : public OSAL::Task
+{
+private:
+    time_sample_cb_t     m_on_sample;
+    Nmea                 m_nmea;
+    esp_pm_lock_handle_t m_pm_lock = nullptr;
+    bool                 m_uart = false;
+    int64_t              m_heard_us = 0;    ///< monotonic time of the last good sentence
+    int64_t              m_offered_us = 0;  ///< monotonic time of the last offer
+    gps_stats_t          m_stats = {};
+
+    static void pps_isr(void* arg);
+    void on_fix(int64_t mono_us) noexcept;
+
+public:
+    explicit Gps(time_sample_cb_t on_sample) noexcept : OSAL::Task{}, m_on_sample{on_sample} {}
+
+    const gps_stats_t&  get_stats() const noexcept { return m_stats; }
+    const nmea_stats_t& get_nmea_stats() const noexcept { return m_nmea.get_stats(); }
+
+    /**
+     * @brief log fixes, PPS alignment and parser counters
+     */
+    void log_stats() const noexcept;
+
+private:
+    void setup() noexcept final;
+    void run() noexcept final;
+    void teardown() noexcept final;
+};
+
+#endif //EXPERIMENTS_GPS_H
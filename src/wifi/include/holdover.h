@@ -0,0 +1,68 @@
+#ifndef EXPERIMENTS_HOLDOVER_H
+#define EXPERIMENTS_HOLDOVER_H
+
+#include <cstdint>
+
+#define HOLDOVER_SYNC_UNCERTAINTY_US 50000   ///< uncertainty right after an SNTP sync
+#define HOLDOVER_DRIFT_UNCERTAINTY   20      ///< ppm, crystal error not covered by the measured drift
+#define HOLDOVER_NVS_PERIOD_S        3600    ///< NVS copy refresh, bounds flash wear
+
+enum holdover_source_t {
+    HOLDOVER_NONE,    ///< nothing stored, clock starts from zero
+    HOLDOVER_SYSTEM,  ///< system clock survived the reset
+    HOLDOVER_RTC,     ///< RTC slow memory and the RTC counter
+    HOLDOVER_NVS,     ///< NVS copy, time spent powered off is unknown
+};
+
+/**
+ * @brief stored clock state
+ */
+struct holdover_t {
+    int64_t  saved_us;        ///< UTC time of the save
+    uint64_t saved_rtc_us;    ///< RTC counter at the save
+    int64_t  synced_us;       ///< UTC time of the last sync
+    uint32_t magic;
+    uint32_t uncertainty_us;  ///< uncertainty at the last sync
+    int32_t  drift_ppb;       ///< measured crystal drift, positive - clock runs fast
+    uint32_t crc;             ///< last, widest fields first: no padding goes into the checksum
+};
+
+/**
+ * @brief result of a restore
+ */
+struct holdover_restore_t {
+    holdover_source_t source;
+    int64_t           uncertainty_ms;  ///< -1 - unknown
+};
+
+/**
+ * @brief seed system clock from the stored state, call before any network activity
+ *
+ * @return where the time came from and how far it can be off
+ */
+holdover_restore_t holdover_restore() noexcept;
+
+/**
+ * @brief record a sync
+ *
+ * @param [in] uncertainty_us uncertainty of the synced time
+ * @param [in] drift_ppb      measured crystal drift
+ */
+void holdover_synced(uint32_t uncertainty_us, int32_t drift_ppb) noexcept;
+
+/**
+ * @brief refresh stored state, RTC copy every call, NVS copy every @ref HOLDOVER_NVS_PERIOD_S
+ */
+void holdover_save() noexcept;
+
+/**
+ * @brief stored crystal drift, 0 - unknown
+ */
+int32_t holdover_drift_ppb() noexcept;
+
+/**
+ * @brief current uncertainty of the system clock in ms, -1 - unknown
+ */
+int64_t holdover_uncertainty_ms() noexcept;
+
+#endif //EXPERIMENTS_HOLDOVER_H
@@ -0,0 +1,66 @@
+#ifndef EXPERIMENTS_NET_H
+#define EXPERIMENTS_NET_H
+
+#include <cstdint>
+
+#include "ntp.h"
+
+#define NET_RETRY_MIN_MS 1000     ///< first reconnect delay
+#define NET_RETRY_MAX_MS 300000   ///< reconnect delay doubles up to 5 minutes
+#define NET_WINDOW_MS    20000    ///< default radio window for a sync
+#define NET_RADIO_MA     80       ///< supply current the radio adds while on, estimate for reports
+#define NET_SUPPLY_MV    3300
+
+enum net_state_t {
+    NET_OFF,         ///< not started
+    NET_CONNECTING,  ///< association or DHCP in progress
+    NET_BACKOFF,     ///< waiting before the next connection attempt
+    NET_ONLINE,      ///< got IP
+    NET_ASLEEP,      ///< radio stopped between sync windows
+};
+
+/**
+ * @brief bring WiFi up in the background
+ *
+ * Returns right away, connection and reconnects are driven by events. The other calls post their
+ * request to the default event loop, every state change happens there
+ *
+ * @param [in] ntp NTP client told about connectivity changes
+ *
+ * @retval true  started
+ * @retval false WiFi couldn't be initialized
+ */
+bool net_start(Ntp* ntp) noexcept;
+
+net_state_t net_get_state() noexcept;
+
+/**
+ * @brief choose between a radio kept on in modem sleep and a radio started for sync windows only
+ *
+ * @param [in] on        duty cycle the radio
+ * @param [in] window_ms longest window to wait for a connection
+ */
+void net_set_duty_cycle(bool on, uint32_t window_ms) noexcept;
+
+bool     net_duty_cycle() noexcept;
+uint32_t net_window_ms() noexcept;
+
+/**
+ * @brief open a radio window
+ *
+ * @retval true  radio is starting or already up, wait for NTP_ONLINE
+ * @retval false radio is managed permanently, nothing to do
+ */
+bool net_wake() noexcept;
+
+/**
+ * @brief close a radio window, no effect without duty cycling
+ */
+void net_sleep() noexcept;
+
+/**
+ * @brief log radio-on time per day and the estimated saving
+ */
+void net_log_stats() noexcept;
+
+#endif //EXPERIMENTS_NET_H
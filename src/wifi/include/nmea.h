@@ -0,0 +1,84 @@
+#ifndef EXPERIMENTS_NMEA_H
+#define EXPERIMENTS_NMEA_H
+
+#include <cstdint>
+#include <cstddef>
+#include <ctime>
+#include <span>
+
+/**
+ * @brief time of a recommended minimum (RMC) sentence
+ */
+struct nmea_fix_t {
+    time_t  utc;      ///< whole seconds
+    int32_t utc_us;   ///< fraction of the second
+    bool    valid;    ///< receiver reports a fix, status 'A'
+};
+
+/**
+ * @brief parser statistics
+ */
+struct nmea_stats_t {
+    uint32_t bytes;
+    uint32_t sentences;  ///< sentences with a good checksum
+    uint32_t fixes;      ///< RMC sentences with time and date
+    uint32_t errors;     ///< bad checksums, truncated or malformed sentences
+};
+
+/**
+ * @class Nmea
+ * @brief streaming NMEA 0183 parser
+ *
+ * Bytes are consumed straight from the caller's buffer: there is no line buffer, the checksum
+ * and the few RMC fields needed for time are accumulated while the sentence goes by. A chunk may
+ * end anywhere, even in the middle of a field. Other sentences are only checksummed.
+ */
+class Nmea
+{
+private:
+    enum state_t : uint8_t {
+        NMEA_IDLE,         ///< waiting for '$'
+        NMEA_BODY,         ///< between '$' and '*'
+        NMEA_CHECKSUM_HI,
+        NMEA_CHECKSUM_LO,
+    };
+
+    state_t  m_state = NMEA_IDLE;
+    uint8_t  m_sum = 0;
+    uint8_t  m_expected = 0;
+    uint8_t  m_field = 0;    ///< field index, 0 - talker and sentence
+    uint8_t  m_pos = 0;      ///< character index in the field
+    bool     m_rmc = false;  ///< sentence is RMC so far
+
+    uint32_t m_hms = 0;      ///< RMC time hhmmss
+    uint32_t m_frac = 0;     ///< RMC time fraction
+    uint32_t m_scale = 1;    ///< divisor of @ref m_frac
+    uint8_t  m_hms_digits = 0;
+    bool     m_in_frac = false;
+    char     m_status = 0;
+    uint32_t m_dmy = 0;      ///< RMC date ddmmyy
+    uint8_t  m_dmy_digits = 0;
+
+    nmea_fix_t   m_fix = {};
+    nmea_stats_t m_stats = {};
+
+    void start() noexcept;
+    void body(char c) noexcept;
+    bool finish() noexcept;
+
+public:
+    /**
+     * @brief consume bytes until the end of the data or of the next RMC sentence with time
+     *
+     * @param [in]  data  received bytes
+     * @param [out] ready @ref fix holds a new time
+     *
+     * @return bytes consumed, call again with the rest
+     */
+    size_t parse(std::span<const uint8_t> data, bool& ready) noexcept;
+
+    const nmea_fix_t&   fix() const noexcept { return m_fix; }
+    const nmea_stats_t& get_stats() const noexcept { return m_stats; }
+};
+
+#endif //EXPERIMENTS_NMEA_H
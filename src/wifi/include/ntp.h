@@ -0,0 +1,142 @@
+#ifndef EXPERIMENTS_NTP_H
+#define EXPERIMENTS_NTP_H
+
+#include <cstdint>
+#include <cstddef>
+
+#include "osal.h"
+#include "timesource.h"
+
+#define NTP_MAX_SERVERS     4
+#define NTP_HOST_LEN        32
+#define NTP_SERVERS_LEN     96        ///< "host[:port],host[:port],..." with terminator
+#define NTP_DEFAULT_SERVERS "pool.ntp.org,time.google.com,time.cloudflare.com"
+#define NTP_PORT            123
+#define NTP_TIMEOUT_MS      1000      ///< reply timeout of one query
+#define NTP_MIN_POLL_S      64
+#define NTP_MAX_POLL_S      36864     ///< ~10 h, drift keeps the clock within budget meanwhile
+#define NTP_BUDGET_US       20000     ///< offset the poll interval is tuned for
+#define NTP_RTT_GAIN        4         ///< smoothed RTT takes 1/4 of every new one
+
+/**
+ * @brief time sample callback
+ *
+ * Called from the source's task with a measured offset. The clock isn't touched there, the sample
+ * is handed to the timer task which selects the source and corrects the clock; keep it short
+ *
+ * @param [in] source         measuring source
+ * @param [in] offset_us      reference minus clock time
+ * @param [in] uncertainty_us how far the offset can be off
+ */
+typedef void(*time_sample_cb_t)(time_source_t source, int64_t offset_us, uint32_t uncertainty_us);
+
+enum ntp_event_t {
+    NTP_ONLINE,       ///< network is up
+    NTP_OFFLINE,      ///< network is down
+    NTP_SYNC_NOW,     ///< poll right away
+    NTP_SET_SERVERS,  ///< replace server list
+};
+
+struct ntp_msg_t {
+    ntp_event_t event;
+
+    union {
+        uint8_t nothing;
+        char    servers[NTP_SERVERS_LEN];  ///< NTP_SET_SERVERS: stored in NVS
+    } u;
+};
+
+/**
+ * @brief NTP client statistics
+ */
+struct ntp_stats_t {
+    uint32_t polls;          ///< poll rounds
+    uint32_t failures;       ///< rounds without a usable reply
+    uint32_t queries;        ///< requests sent
+    int64_t  rtt_us;         ///< round trip of the last selected reply
+    int64_t  offset_us;      ///< offset of the last selected reply
+    int64_t  latency_us;     ///< duration of the last poll round
+    uint32_t interval_s;     ///< current poll interval
+    uint32_t packets;        ///< datagrams sent and received
+    int64_t  first_sync_us;  ///< esp_timer time of the first sync, 0 - not synced yet
+    int64_t  steady_sum_us;  ///< sum of offset magnitudes after the first sync
+    uint32_t steady_num;
+};
+
+/**
+ * @class Ntp
+ * @brief SNTP client with several servers, RTT based selection, backoff and adaptive poll interval
+ *
+ * Every round queries all servers not backing off and uses the reply with the shortest round
+ * trip, it has the smallest possible error. Failed servers back off exponentially. The poll
+ * interval doubles while the offsets stay well inside @ref NTP_BUDGET_US and halves when they
+ * don't, so a well disciplined clock is polled rarely. Offsets are handed to the timer task.
+ * With a duty cycled radio every round opens a radio window and closes it when done.
+ */
+class Ntp final : public OSAL::Task
+{
+private:
+    struct server_t {
+        char     host[NTP_HOST_LEN];
+        uint16_t port;
+        int64_t  rtt_us;        ///< smoothed round trip, 0 - unknown
+        uint8_t  fails;         ///< consecutive failures
+        int64_t  retry_us;      ///< monotonic time the server is usable again
+    };
+
+    OSAL::Queue<ntp_msg_t, 4> m_queue {nullptr};
+
+    time_sample_cb_t m_on_sample;
+    server_t         m_servers[NTP_MAX_SERVERS] = {};
+    size_t           m_server_num = 0;
+    bool             m_online = false;
+    bool             m_waking = false;     ///< radio window opened for the next round
+    int64_t          m_window_end_us = 0;  ///< monotonic time the window gives up
+    uint8_t          m_fails = 0;          ///< consecutive failed rounds
+    int64_t          m_next_poll_us = 0;   ///< monotonic time of the next round
+    uint32_t         m_interval_s = NTP_MIN_POLL_S;
+    ntp_stats_t      m_stats = {};         ///< NTP task only
+    ntp_stats_t      m_shared = {};        ///< snapshot of m_stats for other tasks
+    mutable portMUX_TYPE m_stats_lock = portMUX_INITIALIZER_UNLOCKED;  ///< guards m_shared
+
+    bool set_servers(const char* list) noexcept;
+    bool query(server_t& server, int64_t& offset_us, int64_t& rtt_us) noexcept;
+    void poll() noexcept;
+    void round() noexcept;
+    void handle(const ntp_msg_t& msg) noexcept;
+    void publish() noexcept;
+
+public:
+    explicit Ntp(time_sample_cb_t on_sample) noexcept : OSAL::Task{}, m_on_sample{on_sample} {}
+
+    /**
+     * @brief post event to the client
+     *
+     * @param [in] msg event
+     *
+     * @retval true  event queued
+     * @retval false queue full
+     */
+    bool post(const ntp_msg_t& msg) const noexcept { return m_queue.send(&msg, 0); }
+
+    /**
+     * @brief post event without payload
+     */
+    bool post(ntp_event_t event) const noexcept;
+
+    /**
+     * @brief copy statistics as of the last finished round, any task
+     */
+    ntp_stats_t get_stats() const noexcept;
+
+    /**
+     * @brief log time to first sync, steady state offset and traffic per day, any task
+     */
+    void log_stats() const noexcept;
+
+private:
+    void setup() noexcept final;
+    void run() noexcept final;
+};
+
+#endif //EXPERIMENTS_NTP_H
@@ -0,0 +1,53 @@
+#ifndef EXPERIMENTS_RTC_SOURCE_H
+#define EXPERIMENTS_RTC_SOURCE_H
+
+#include <cstdint>
+
+#include "ds3231.h"
+
+#define RTC_SOURCE_READ_US      500000     ///< whole seconds only, the read is taken mid-second
+#define RTC_SOURCE_PPM          2          ///< DS3231 accuracy from 0 to +40 C
+#define RTC_SOURCE_PPM_EXTENDED 4          ///< outside of it, -40 to +85 C is 3.5 ppm
+
+/**
+ * @brief external RTC statistics
+ */
+struct rtc_source_stats_t {
+    bool     present;    ///< device answered at boot
+    uint32_t reads;
+    uint32_t writes;
+    uint32_t failures;
+    int64_t  offset_us;  ///< RTC minus system clock at the boot read
+};
+
+/**
+ * @brief attach the external RTC to the owner of its bus, call before the timer starts
+ *
+ * @param [in] read  register read of the bus owner
+ * @param [in] write register write of the bus owner
+ */
+void rtc_source_attach(ds3231_read_t read, ds3231_write_t write) noexcept;
+
+/**
+ * @brief read the external RTC and offer it as a time source, call once at boot
+ *
+ * The clock is stepped only if the RTC is better than the restored holdover.
+ *
+ * @retval true  clock was set from the RTC
+ * @retval false no RTC, RTC lost its time or holdover is better
+ */
+bool rtc_source_restore() noexcept;
+
+/**
+ * @brief write the system clock to the external RTC, call right after a second boundary
+ *
+ * Remembers the write time in NVS to tell the RTC uncertainty at the next boot
+ *
+ * @retval true  RTC holds the time or there is no RTC
+ * @retval false write failed, try again
+ */
+bool rtc_source_save() noexcept;
+
+const rtc_source_stats_t& rtc_source_get_stats() noexcept;
+
+#endif //EXPERIMENTS_RTC_SOURCE_H
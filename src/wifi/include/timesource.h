@@ -0,0 +1,60 @@
+#ifndef EXPERIMENTS_TIMESOURCE_H
+#define EXPERIMENTS_TIMESOURCE_H
+
+#include <cstdint>
+
+#define TIMESOURCE_PREFER_US 10000  ///< a higher priority source wins unless worse by more than this
+
+enum time_source_t {
+    TIME_SOURCE_NONE,
+    TIME_SOURCE_HOLDOVER,  ///< clock state kept over the reset, see holdover.h
+    TIME_SOURCE_RTC,       ///< battery backed external RTC
+    TIME_SOURCE_NTP,
+    TIME_SOURCE_GPS,       ///< NMEA receiver, PPS aligned when wired
+
+    TIME_SOURCE_NUM
+};
+
+/**
+ * @brief time source statistics
+ */
+struct timesource_stats_t {
+    uint32_t offers[TIME_SOURCE_NUM];  ///< samples offered by every source
+    uint32_t taken[TIME_SOURCE_NUM];   ///< samples allowed to set the clock
+};
+
+/**
+ * @brief ask whether a source may set the clock
+ *
+ * The source in charge always may. Another one takes over when it has a higher priority
+ * and its uncertainty is within @ref TIMESOURCE_PREFER_US of the clock's, or when it is
+ * better than the clock's by more than that. The clock's uncertainty comes from holdover.h
+ * and grows with the time since the last accepted sample. Not locked, sources hand their samples
+ * to the timer task which calls it.
+ *
+ * @param [in] source         offering source
+ * @param [in] uncertainty_us how far the sample can be off, -1 - unknown
+ *
+ * @retval true  source is in charge now, apply the sample and record it with holdover_synced
+ * @retval false keep the clock as it is
+ */
+bool timesource_offer(time_source_t source, int64_t uncertainty_us) noexcept;
+
+/**
+ * @brief change the priority of a source, stored in NVS
+ *
+ * @param [in] source   source
+ * @param [in] priority higher wins, 0 - source is ignored
+ */
+bool timesource_set_priority(time_source_t source, uint8_t priority) noexcept;
+
+/**
+ * @brief restore priorities from NVS
+ */
+void timesource_load() noexcept;
+
+time_source_t timesource_current() noexcept;
+const char* timesource_name(time_source_t source) noexcept;
+const timesource_stats_t& timesource_get_stats() noexcept;
+
+#endif //EXPERIMENTS_TIMESOURCE_H
@@ -0,0 +1,109 @@
+#ifndef EXPERIMENTS_TZ_H
+#define EXPERIMENTS_TZ_H
+
+#include <cstdint>
+#include <cstddef>
+#include <ctime>
+
+#define TZ_MAX_LEN         48  ///< POSIX TZ string with terminator
+#define TZ_NAME_LEN        8   ///< zone abbreviation with terminator
+#define TZ_YEARS           8   ///< years covered by a transition table
+#define TZ_MAX_TRANSITIONS (2 * TZ_YEARS)
+
+/**
+ * @brief day a DST change happens on
+ */
+struct tz_date_t {
+    enum : uint8_t {
+        TZ_DATE_MONTH,   ///< Mm.w.d - day d of week w of month m
+        TZ_DATE_JULIAN,  ///< Jn    - day n of 1 .. 365, February 29 never counted
+        TZ_DATE_YDAY,    ///< n     - day n of 0 .. 365
+    } type;
+    uint8_t  month;      ///< 1 .. 12
+    uint8_t  week;       ///< 1 .. 5, 5 - last
+    uint8_t  wday;       ///< 0 .. 6, 0 - Sunday
+    uint16_t day;
+    int32_t  time;       ///< seconds after local midnight
+};
+
+/**
+ * @brief parsed POSIX TZ rule, offsets are seconds east of UTC
+ */
+struct tz_rule_t {
+    char      std_name[TZ_NAME_LEN];
+    char      dst_name[TZ_NAME_LEN];
+    int32_t   std_offset;
+    int32_t   dst_offset;
+    bool      has_dst;
+    tz_date_t start;      ///< standard to daylight time, in standard local time
+    tz_date_t end;        ///< daylight to standard time, in daylight local time
+};
+
+/**
+ * @brief UTC offset change
+ */
+struct tz_transition_t {
+    time_t  at;      ///< UTC time of the change
+    int32_t offset;  ///< offset from @ref at on
+    bool    dst;     ///< daylight time from @ref at on
+};
+
+/**
+ * @brief compiled transitions of a rule
+ */
+struct tz_table_t {
+    tz_transition_t transitions[TZ_MAX_TRANSITIONS];
+    size_t          len;
+    time_t          from;   ///< first covered UTC time
+    time_t          until;  ///< first UTC time not covered
+    int32_t         offset; ///< offset at @ref from
+    bool            dst;    ///< daylight time at @ref from
+};
+
+/**
+ * @brief parse POSIX TZ string, e.g. "EET-2EEST,M3.5.0/3,M10.5.0/4"
+ *
+ * @param [in]  str  TZ string
+ * @param [out] rule parsed rule
+ *
+ * @retval true  parsed
+ * @retval false malformed or unsupported string
+ */
+bool tz_parse(const char* str, tz_rule_t& rule) noexcept;
+
+/**
+ * @brief compile transitions of @ref TZ_YEARS years starting with @p year
+ *
+ * @param [in]  rule  rule
+ * @param [in]  year  first year
+ * @param [out] table transitions sorted by time
+ */
+void tz_compile(const tz_rule_t& rule, int year, tz_table_t& table) noexcept;
+
+/**
+ * @brief days since 1970-01-01 of a civil date
+ *
+ * @param [in] year year
+ * @param [in] mon  month, 1 - 12
+ * @param [in] day  day of the month, 1 - 31
+ */
+int64_t tz_days_from_civil(int year, int mon, int day) noexcept;
+
+/**
+ * @brief restore TZ string from NVS
+ *
+ * @param [out] str buffer of @ref TZ_MAX_LEN
+ *
+ * @retval true  restored
+ * @retval false nothing stored
+ */
+bool tz_load(char* str) noexcept;
+
+/**
+ * @brief store TZ string to NVS
+ *
+ * @param [in] str TZ string
+ */
+bool tz_save(const char* str) noexcept;
+
+#endif //EXPERIMENTS_TZ_H
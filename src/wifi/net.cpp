@@ -0,0 +1,306 @@
+#include "esp_wifi.h"
+#include "esp_event.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "net.h"
+
+static const char *TAG = "NET";
+
+#define EXAMPLE_ESP_WIFI_SSID      "iHomeWave"
+#define EXAMPLE_ESP_WIFI_PASS      "b@r@b01@"
+
+ESP_EVENT_DEFINE_BASE(NET_EVENT);
+
+/**
+ * @brief requests from other tasks, handled in the event loop with the WiFi events
+ */
+enum net_event_t {
+    NET_EVENT_RETRY,        ///< backoff elapsed
+    NET_EVENT_WAKE,         ///< open a radio window
+    NET_EVENT_SLEEP,        ///< close the radio window
+    NET_EVENT_DUTY_CYCLE,   ///< net_duty_cycle_t follows
+};
+
+struct net_duty_cycle_t {
+    bool     on;
+    uint32_t window_ms;
+};
+
+// changed in the event loop only, other tasks read them
+static volatile net_state_t _state = NET_OFF;
+static volatile bool        _duty_cycle = true;
+static volatile uint32_t    _window_ms = NET_WINDOW_MS;
+
+static Ntp*                 _ntp = nullptr;
+static esp_timer_handle_t   _retry_timer = nullptr;
+static uint32_t             _retry_ms = NET_RETRY_MIN_MS;
+static portMUX_TYPE         _radio_lock = portMUX_INITIALIZER_UNLOCKED;  ///< radio times, read by net_log_stats
+static int64_t              _radio_since_us = 0;  ///< radio start time, 0 - radio off
+static int64_t              _radio_total_us = 0;  ///< radio-on time of closed windows
+
+static void set_state(net_state_t state)
+{
+    static const char* names[] = {"off", "connecting", "backoff", "online", "asleep"};
+    if (_state != state)
+        ESP_LOGI(TAG, "%s -> %s", names[_state], names[state]);
+    _state = state;
+}
+
+static bool post(net_event_t event, const void* data = nullptr, size_t size = 0)
+{
+    // the loop always drains, waiting is fine
+    if (ESP_OK == esp_event_post(NET_EVENT, event, data, size, portMAX_DELAY))
+        return true;
+    ESP_LOGE(TAG, "Could not post event %d", event);
+    return false;
+}
+
+static void retry_cb(void*)
+{
+    post(NET_EVENT_RETRY);
+}
+
+static void radio_on()
+{
+    if (_radio_since_us)
+        return;
+    portENTER_CRITICAL(&_radio_lock);
+    _radio_since_us = esp_timer_get_time();
+    portEXIT_CRITICAL(&_radio_lock);
+    esp_wifi_start();
+}
+
+static void radio_off()
+{
+    if (not _radio_since_us)
+        return;
+    portENTER_CRITICAL(&_radio_lock);
+    _radio_total_us += esp_timer_get_time() - _radio_since_us;
+    _radio_since_us = 0;
+    portEXIT_CRITICAL(&_radio_lock);
+    esp_wifi_stop();
+}
+
+static void net_event(int32_t event_id, const void* event_data)
+{
+    switch (event_id)
+    {
+        case NET_EVENT_RETRY:
+        {
+            // a window closed while the retry was already queued
+            if (_state != NET_BACKOFF)
+                break;
+            set_state(NET_CONNECTING);
+            esp_wifi_connect();
+            break;
+        }
+        case NET_EVENT_WAKE:
+        {
+            if (not _duty_cycle or _state != NET_ASLEEP)
+                break;
+            set_state(NET_CONNECTING);
+            radio_on();
+            break;
+        }
+        case NET_EVENT_SLEEP:
+        {
+            if (not _duty_cycle or _state == NET_OFF or _state == NET_ASLEEP)
+                break;
+            set_state(NET_ASLEEP);
+            esp_timer_stop(_retry_timer);
+            _retry_ms = NET_RETRY_MIN_MS;
+            radio_off();
+            break;
+        }
+        case NET_EVENT_DUTY_CYCLE:
+        {
+            auto* duty = static_cast<const net_duty_cycle_t*>(event_data);
+            _duty_cycle = duty->on;
+            _window_ms  = duty->window_ms;
+            ESP_LOGI(TAG, "Radio %s, window %lu ms", duty->on ? "duty cycled" : "always on", (unsigned long)duty->window_ms);
+
+            if (not duty->on and _state == NET_ASLEEP)
+            {
+                set_state(NET_CONNECTING);
+                radio_on();
+            }
+            break;
+        }
+    }
+}
+
+static void event_handler(void* arg, esp_event_base_t event_base, int32_t event_id, void* event_data)
+{
+    if (event_base == NET_EVENT)
+        net_event(event_id, event_data);
+    else if (event_base == WIFI_EVENT)
+    {
+        switch (event_id)
+        {
+            case WIFI_EVENT_STA_START:
+            {
+                set_state(NET_CONNECTING);
+                esp_wifi_connect();
+                break;
+            }
+            case WIFI_EVENT_STA_DISCONNECTED:
+            {
+                // a closed window, not a lost connection
+                if (_state == NET_ASLEEP)
+                    break;
+
+                // never give up, the clock keeps running on its own meanwhile
+                if (_state == NET_ONLINE)
+                    _ntp->post(NTP_OFFLINE);
+                ESP_LOGI(TAG, "connect to the AP fail, retry in %lu ms", (unsigned long)_retry_ms);
+                set_state(NET_BACKOFF);
+                esp_timer_start_once(_retry_timer, _retry_ms * 1000ULL);
+                _retry_ms = _retry_ms * 2 < NET_RETRY_MAX_MS ? _retry_ms * 2 : NET_RETRY_MAX_MS;
+                break;
+            }
+        }
+    } else if (event_base == IP_EVENT)
+    {
+        switch (event_id)
+        {
+            case IP_EVENT_STA_GOT_IP:
+            {
+                _retry_ms = NET_RETRY_MIN_MS;
+                auto* event = static_cast<ip_event_got_ip_t*>(event_data);
+                ESP_LOGI(TAG, "got ip:" IPSTR, IP2STR(&event->ip_info.ip));
+                set_state(NET_ONLINE);
+                _ntp->post(NTP_ONLINE);
+                break;
+            }
+        }
+    }
+}
+
+bool net_start(Ntp* ntp) noexcept
+{
+    if (_state != NET_OFF)
+        return true;
+    _ntp = ntp;
+
+    const esp_timer_create_args_t args {
+        .callback        = retry_cb,
+        .arg             = nullptr,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name            = "net_retry",
+    };
+    if (ESP_OK != esp_timer_create(&args, &_retry_timer))
+    {
+        ESP_LOGE(TAG, "Could not create retry timer");
+        return false;
+    }
+
+    esp_err_t ret = esp_event_loop_create_default();
+    if (ret != ESP_OK and ret != ESP_ERR_INVALID_STATE)
+        return false;
+    esp_netif_create_default_wifi_sta();
+
+    wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
+    if (ESP_OK != esp_wifi_init(&cfg))
+    {
+        ESP_LOGE(TAG, "Could not init WiFi");
+        return false;
+    }
+
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
+                                                        ESP_EVENT_ANY_ID,
+                                                        &event_handler,
+                                                        nullptr,
+                                                        nullptr));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT,
+                                                        IP_EVENT_STA_GOT_IP,
+                                                        &event_handler,
+                                                        nullptr,
+                                                        nullptr));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(NET_EVENT,
+                                                        ESP_EVENT_ANY_ID,
+                                                        &event_handler,
+                                                        nullptr,
+                                                        nullptr));
+
+    wifi_config_t wifi_config = {
+        .sta = {
+            .ssid = EXAMPLE_ESP_WIFI_SSID,
+            .password = EXAMPLE_ESP_WIFI_PASS,
+            .threshold {
+                    .authmode = WIFI_AUTH_WPA2_PSK
+            },
+            .pmf_cfg = {
+                    .capable  = true,
+                    .required = false
+            },
+        },
+    };
+    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA) );
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config) );
+
+    // between beacons the radio sleeps while a permanent connection is kept
+    esp_wifi_set_ps(WIFI_PS_MIN_MODEM);
+
+    // the first window is open right away, the first sync needs it
+    radio_on();
+
+    ESP_LOGI(TAG, "WiFi started, connecting to SSID:%s in background", EXAMPLE_ESP_WIFI_SSID);
+    return true;
+}
+
+net_state_t net_get_state() noexcept
+{
+    return _state;
+}
+
+void net_set_duty_cycle(bool on, uint32_t window_ms) noexcept
+{
+    const net_duty_cycle_t duty {
+        .on        = on,
+        .window_ms = window_ms ? window_ms : NET_WINDOW_MS,
+    };
+    post(NET_EVENT_DUTY_CYCLE, &duty, sizeof(duty));
+}
+
+bool net_duty_cycle() noexcept
+{
+    return _duty_cycle;
+}
+
+uint32_t net_window_ms() noexcept
+{
+    return _window_ms;
+}
+
+bool net_wake() noexcept
+{
+    if (not _duty_cycle or _state == NET_OFF)
+        return false;
+    return post(NET_EVENT_WAKE);
+}
+
+void net_sleep() noexcept
+{
+    if (_duty_cycle and _state != NET_OFF)
+        post(NET_EVENT_SLEEP);
+}
+
+void net_log_stats() noexcept
+{
+    int64_t uptime_us = esp_timer_get_time();
+    if (uptime_us <= 0)
+        return;
+
+    portENTER_CRITICAL(&_radio_lock);
+    int64_t on_us  = _radio_total_us + (_radio_since_us ? uptime_us - _radio_since_us : 0);
+    portEXIT_CRITICAL(&_radio_lock);
+    int64_t off_us = uptime_us - on_us;
+
+    // without duty cycling the radio would have been on all along
+    ESP_LOGI(TAG, "Radio on %lld s per day (%lld.%01lld%%), saving ~%lld mA / %lld mW on average",
+             (long long)(on_us * 86400 / uptime_us),
+             (long long)(on_us * 100 / uptime_us), (long long)(on_us * 1000 / uptime_us % 10),
+             (long long)(NET_RADIO_MA * off_us / uptime_us),
+             (long long)(NET_RADIO_MA * NET_SUPPLY_MV / 1000 * off_us / uptime_us));
+}
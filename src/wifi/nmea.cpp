@@ -0,0 +1,190 @@
+#include "nmea.h"
+#include "tz.h"
+
+static int hex(char c)
+{
+    if (c >= '0' and c <= '9')
+        return c - '0';
+    if (c >= 'A' and c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+void Nmea::start() noexcept
+{
+    m_state      = NMEA_BODY;
+    m_sum        = 0;
+    m_field      = 0;
+    m_pos        = 0;
+    m_rmc        = true;
+    m_hms        = 0;
+    m_frac       = 0;
+    m_scale      = 1;
+    m_hms_digits = 0;
+    m_in_frac    = false;
+    m_status     = 0;
+    m_dmy        = 0;
+    m_dmy_digits = 0;
+}
+
+void Nmea::body(char c) noexcept
+{
+    m_sum ^= c;
+    if (c == ',')
+    {
+        // "GPRMC", "GNRMC": the sentence is known once the first field ends
+        if (m_field == 0)
+            m_rmc = m_rmc and m_pos == 5;
+        m_field++;
+        m_pos = 0;
+        return;
+    }
+
+    if (m_rmc)
+    {
+        bool digit = c >= '0' and c <= '9';
+        switch (m_field)
+        {
+            case 0:
+            {
+                static const char type[] = "RMC";
+                if (m_pos >= 2 and (m_pos >= 5 or c != type[m_pos - 2]))
+                    m_rmc = false;
+                break;
+            }
+            case 1:
+            {
+                if (c == '.')
+                    m_in_frac = true;
+                else if (not digit)
+                    m_rmc = false;
+                else if (not m_in_frac)
+                {
+                    m_hms = m_hms * 10 + (c - '0');
+                    m_hms_digits++;
+                }
+                else if (m_scale < 1000000)
+                {
+                    m_frac  = m_frac * 10 + (c - '0');
+                    m_scale *= 10;
+                }
+                break;
+            }
+            case 2:
+            {
+                m_status = c;
+                break;
+            }
+            case 9:
+            {
+                if (not digit)
+                    m_rmc = false;
+                m_dmy = m_dmy * 10 + (c - '0');
+                m_dmy_digits++;
+                break;
+            }
+            default:
+                break;
+        }
+    }
+    m_pos++;
+}
+
+bool Nmea::finish() noexcept
+{
+    if (m_sum != m_expected)
+    {
+        m_stats.errors++;
+        return false;
+    }
+    m_stats.sentences++;
+
+    if (not m_rmc or m_field < 9)
+        return false;
+    if (m_hms_digits != 6 or m_dmy_digits != 6)
+    {
+        // a receiver without a fix may send empty time and date
+        if (m_hms_digits or m_dmy_digits)
+            m_stats.errors++;
+        return false;
+    }
+
+    int hour = m_hms / 10000, min = m_hms / 100 % 100, sec = m_hms % 100;
+    int day  = m_dmy / 10000, mon = m_dmy / 100 % 100, year = 2000 + m_dmy % 100;
+    if (hour > 23 or min > 59 or sec > 60 or day < 1 or day > 31 or mon < 1 or mon > 12)
+    {
+        m_stats.errors++;
+        return false;
+    }
+
+    m_fix.utc    = static_cast<time_t>(tz_days_from_civil(year, mon, day) * 86400 + hour * 3600 + min * 60 + sec);
+    m_fix.utc_us = static_cast<int32_t>(m_frac * (1000000 / m_scale));
+    m_fix.valid  = m_status == 'A';
+    m_stats.fixes++;
+    return true;
+}
+
+size_t Nmea::parse(std::span<const uint8_t> data, bool& ready) noexcept
+{
+    ready = false;
+    size_t i = 0;
+    while (i < data.size())
+    {
+        char c = static_cast<char>(data[i++]);
+        if (c == '$')
+        {
+            if (m_state != NMEA_IDLE)
+                m_stats.errors++;
+            start();
+            continue;
+        }
+
+        switch (m_state)
+        {
+            case NMEA_IDLE:
+                break;
+            case NMEA_BODY:
+            {
+                if (c == '*')
+                    m_state = NMEA_CHECKSUM_HI;
+                else if (c == '\r' or c == '\n')
+                {
+                    // checksum is optional in the standard, receivers always send it
+                    m_stats.errors++;
+                    m_state = NMEA_IDLE;
+                }
+                else
+                    body(c);
+                break;
+            }
+            case NMEA_CHECKSUM_HI:
+            case NMEA_CHECKSUM_LO:
+            {
+                int v = hex(c);
+                if (v < 0)
+                {
+                    m_stats.errors++;
+                    m_state = NMEA_IDLE;
+                    break;
+                }
+                if (m_state == NMEA_CHECKSUM_HI)
+                {
+                    m_expected = v << 4;
+                    m_state    = NMEA_CHECKSUM_LO;
+                    break;
+                }
+                m_expected |= v;
+                m_state = NMEA_IDLE;
+                if (finish())
+                {
+                    ready = true;
+                    m_stats.bytes += i;
+                    return i;
+                }
+                break;
+            }
+        }
+    }
+    m_stats.bytes += i;
+    return i;
+}
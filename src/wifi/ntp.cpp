@@ -0,0 +1,394 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdlib>
+#include <sys/time.h>
+
+#include "lwip/sockets.h"
+#include "lwip/netdb.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "nvs.h"
+
+#include "ntp.h"
+#include "net.h"
+
+static const char *TAG = "NTP";
+
+static const char *NVS_NAMESPACE = "timer";
+static const char *NVS_KEY       = "ntp";
+
+#define NTP_PACKET_LEN  48
+#define NTP_UNIX_OFFSET 2208988800ULL  ///< seconds from 1900 to 1970
+#define NTP_RETRY_S     8              ///< first retry after a failed round, doubles up to NTP_MAX_POLL_S
+
+static int64_t wall_time_us()
+{
+    timeval tv;
+    gettimeofday(&tv, nullptr);
+    return static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+static void to_ntp(int64_t us, uint8_t* out)
+{
+    uint64_t sec  = us / 1000000 + NTP_UNIX_OFFSET;
+    uint64_t frac = (static_cast<uint64_t>(us % 1000000) << 32) / 1000000;
+    uint64_t ts   = sec << 32 | frac;
+    for (int i = 7; i >= 0; i--, ts >>= 8)
+        out[i] = ts & 0xFF;
+}
+
+static int64_t from_ntp(const uint8_t* in)
+{
+    uint64_t ts = 0;
+    for (int i = 0; i < 8; i++)
+        ts = ts << 8 | in[i];
+    int64_t sec = static_cast<int64_t>(ts >> 32) - static_cast<int64_t>(NTP_UNIX_OFFSET);
+    return sec * 1000000 + static_cast<int64_t>(((ts & 0xFFFFFFFF) * 1000000) >> 32);
+}
+
+static uint32_t backoff_s(uint8_t fails)
+{
+    uint32_t delay = NTP_RETRY_S << (fails < 12 ? fails : 12);
+    return delay < NTP_MAX_POLL_S ? delay : NTP_MAX_POLL_S;
+}
+
+bool Ntp::post(ntp_event_t event) const noexcept
+{
+    ntp_msg_t msg {
+        .event = event,
+        .u = {},
+    };
+    return post(msg);
+}
+
+bool Ntp::set_servers(const char* list) noexcept
+{
+    server_t servers[NTP_MAX_SERVERS] = {};
+    size_t   num = 0;
+
+    for (const char* pos = list; *pos and num < NTP_MAX_SERVERS;)
+    {
+        while (*pos == ' ' or *pos == ',')
+            pos++;
+        size_t len = strcspn(pos, ":,");
+        if (not len)
+            break;
+        if (len >= NTP_HOST_LEN)
+        {
+            ESP_LOGE(TAG, "Server name too long");
+            return false;
+        }
+
+        server_t& server = servers[num++];
+        memcpy(server.host, pos, len);
+        server.port = NTP_PORT;
+        pos += len;
+
+        if (*pos == ':')
+        {
+            char* end;
+            long port = strtol(pos + 1, &end, 10);
+            if (port <= 0 or port > UINT16_MAX)
+            {
+                ESP_LOGE(TAG, "Bad port of %s", server.host);
+                return false;
+            }
+            server.port = static_cast<uint16_t>(port);
+            pos = end;
+        }
+    }
+
+    if (not num)
+        return false;
+
+    memcpy(m_servers, servers, sizeof(servers));
+    m_server_num = num;
+    for (size_t i = 0; i < num; i++)
+        ESP_LOGI(TAG, "Server %u: %s:%u", (unsigned)i, m_servers[i].host, m_servers[i].port);
+    return true;
+}
+
+bool Ntp::query(server_t& server, int64_t& offset_us, int64_t& rtt_us) noexcept
+{
+    addrinfo hints = {};
+    hints.ai_family   = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+
+    char port[6];
+    snprintf(port, sizeof(port), "%u", server.port);
+
+    addrinfo* res = nullptr;
+    if (getaddrinfo(server.host, port, &hints, &res) != 0 or not res)
+    {
+        ESP_LOGW(TAG, "Could not resolve %s", server.host);
+        return false;
+    }
+
+    int sock = socket(res->ai_family, res->ai_socktype, 0);
+    if (sock < 0)
+    {
+        freeaddrinfo(res);
+        return false;
+    }
+
+    const timeval timeout {
+        .tv_sec  = NTP_TIMEOUT_MS / 1000,
+        .tv_usec = (NTP_TIMEOUT_MS % 1000) * 1000,
+    };
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    // LI 0, version 4, client; our transmit time comes back as origin and ties the reply to the request
+    uint8_t packet[NTP_PACKET_LEN] = {0x23};
+    uint8_t origin[8];
+    int64_t t1 = wall_time_us();
+    to_ntp(t1, origin);
+    memcpy(packet + 40, origin, sizeof(origin));
+
+    bool    ok = false;
+    int64_t t4 = 0;
+    if (sendto(sock, packet, sizeof(packet), 0, res->ai_addr, res->ai_addrlen) == sizeof(packet))
+    {
+        m_stats.packets++;
+        int len = recv(sock, packet, sizeof(packet), 0);
+        t4 = wall_time_us();
+        m_stats.packets += len > 0;
+        ok = len >= NTP_PACKET_LEN and (packet[0] & 0x07) == 4 and (packet[0] >> 6) != 3 and
+             packet[1] >= 1 and packet[1] <= 15 and not memcmp(packet + 24, origin, sizeof(origin));
+    }
+    close(sock);
+    freeaddrinfo(res);
+
+    if (not ok)
+    {
+        ESP_LOGW(TAG, "No valid reply from %s", server.host);
+        return false;
+    }
+
+    int64_t t2 = from_ntp(packet + 32);
+    int64_t t3 = from_ntp(packet + 40);
+    offset_us = ((t2 - t1) + (t3 - t4)) / 2;
+    rtt_us    = (t4 - t1) - (t3 - t2);
+    return true;
+}
+
+void Ntp::poll() noexcept
+{
+    int64_t start = esp_timer_get_time();
+    m_stats.polls++;
+
+    server_t* best = nullptr;
+    int64_t   best_offset = 0;
+    int64_t   best_rtt = 0;
+    for (size_t i = 0; i < m_server_num; i++)
+    {
+        server_t& server = m_servers[i];
+        if (server.retry_us > start)
+            continue;
+
+        int64_t offset_us, rtt_us;
+        m_stats.queries++;
+        if (not query(server, offset_us, rtt_us))
+        {
+            server.fails++;
+            server.retry_us = esp_timer_get_time() + backoff_s(server.fails) * 1000000LL;
+            continue;
+        }
+
+        server.fails    = 0;
+        server.retry_us = 0;
+        server.rtt_us   = server.rtt_us ? server.rtt_us + (rtt_us - server.rtt_us) / NTP_RTT_GAIN : rtt_us;
+
+        // the shortest round trip bounds the offset error best
+        if (not best or rtt_us < best_rtt)
+        {
+            best        = &server;
+            best_offset = offset_us;
+            best_rtt    = rtt_us;
+        }
+    }
+
+    int64_t now = esp_timer_get_time();
+    m_stats.latency_us = now - start;
+
+    if (not best)
+    {
+        m_stats.failures++;
+        m_fails++;
+        m_next_poll_us = now + backoff_s(m_fails) * 1000000LL;
+        ESP_LOGW(TAG, "No server answered, retry in %lu s", (unsigned long)backoff_s(m_fails));
+        return;
+    }
+    m_fails = 0;
+
+    // the offset of a reply is off by half its round trip at most; a better source may be in
+    // charge, the reply still tunes the poll interval
+    if (m_on_sample)
+        m_on_sample(TIME_SOURCE_NTP, best_offset, static_cast<uint32_t>(best_rtt / 2));
+
+    int64_t magnitude = best_offset < 0 ? -best_offset : best_offset;
+    // 64 s doubled never lands on the 36864 s maximum, clamp the last step
+    if (magnitude < NTP_BUDGET_US / 4 and m_interval_s < NTP_MAX_POLL_S)
+        m_interval_s = m_interval_s * 2 < NTP_MAX_POLL_S ? m_interval_s * 2 : NTP_MAX_POLL_S;
+    else if (magnitude > NTP_BUDGET_US / 2 and m_interval_s > NTP_MIN_POLL_S)
+        m_interval_s /= 2;
+    m_next_poll_us = now + m_interval_s * 1000000LL;
+
+    m_stats.offset_us  = best_offset;
+    m_stats.rtt_us     = best_rtt;
+    m_stats.interval_s = m_interval_s;
+    if (m_stats.first_sync_us)
+    {
+        m_stats.steady_sum_us += magnitude;
+        m_stats.steady_num++;
+    }
+    else
+        m_stats.first_sync_us = now;
+    ESP_LOGI(TAG, "%s: offset %lld us, rtt %lld us, round took %lld us, next poll in %lu s",
+             best->host, (long long)best_offset, (long long)best_rtt, (long long)m_stats.latency_us,
+             (unsigned long)m_interval_s);
+}
+
+void Ntp::publish() noexcept
+{
+    // 64 bit fields can't be read in one go, the timer task would see torn values
+    portENTER_CRITICAL(&m_stats_lock);
+    m_shared = m_stats;
+    portEXIT_CRITICAL(&m_stats_lock);
+}
+
+ntp_stats_t Ntp::get_stats() const noexcept
+{
+    portENTER_CRITICAL(&m_stats_lock);
+    ntp_stats_t ret = m_shared;
+    portEXIT_CRITICAL(&m_stats_lock);
+    return ret;
+}
+
+void Ntp::log_stats() const noexcept
+{
+    int64_t uptime_us = esp_timer_get_time();
+    if (uptime_us <= 0)
+        return;
+
+    ntp_stats_t stats = get_stats();
+    ESP_LOGI(TAG, "First sync after %lld ms, steady offset %lld us over %lu syncs, %llu packets per day",
+             (long long)(stats.first_sync_us / 1000),
+             (long long)(stats.steady_num ? stats.steady_sum_us / stats.steady_num : 0),
+             (unsigned long)stats.steady_num,
+             (unsigned long long)(stats.packets * 86400000000ULL / uptime_us));
+}
+
+void Ntp::handle(const ntp_msg_t& msg) noexcept
+{
+    switch (msg.event)
+    {
+        case NTP_ONLINE:
+        {
+            m_online = true;
+            // nothing synced yet, don't wait for the schedule
+            if (not m_stats.first_sync_us)
+                m_next_poll_us = 0;
+            break;
+        }
+        case NTP_OFFLINE:
+        {
+            m_online = false;
+            break;
+        }
+        case NTP_SYNC_NOW:
+        {
+            m_next_poll_us = 0;
+            break;
+        }
+        case NTP_SET_SERVERS:
+        {
+            if (not set_servers(msg.u.servers))
+            {
+                ESP_LOGE(TAG, "Malformed server list \"%s\"", msg.u.servers);
+                break;
+            }
+
+            nvs_handle_t handle;
+            if (ESP_OK == nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle))
+            {
+                if (ESP_OK != nvs_set_str(handle, NVS_KEY, msg.u.servers) or ESP_OK != nvs_commit(handle))
+                    ESP_LOGE(TAG, "Could not store server list");
+                nvs_close(handle);
+            }
+            m_fails        = 0;
+            m_interval_s   = NTP_MIN_POLL_S;
+            m_next_poll_us = 0;
+            break;
+        }
+    }
+}
+
+void Ntp::setup() noexcept
+{
+    char   list[NTP_SERVERS_LEN];
+    size_t size = sizeof(list);
+
+    nvs_handle_t handle;
+    bool loaded = false;
+    if (ESP_OK == nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle))
+    {
+        loaded = ESP_OK == nvs_get_str(handle, NVS_KEY, list, &size);
+        nvs_close(handle);
+    }
+
+    if (not loaded or not set_servers(list))
+        set_servers(NTP_DEFAULT_SERVERS);
+}
+
+void Ntp::round() noexcept
+{
+    m_waking = false;
+    poll();
+    publish();
+    if (net_duty_cycle())
+    {
+        net_sleep();
+        m_online = false;
+    }
+}
+
+void Ntp::run() noexcept
+{
+    while (1)
+    {
+        int64_t  now_us  = esp_timer_get_time();
+        uint32_t wait_ms = UINT32_MAX;
+
+        if (m_next_poll_us > now_us)
+            wait_ms = static_cast<uint32_t>((m_next_poll_us - now_us) / 1000 + 1);
+        else if (m_online)
+        {
+            round();
+            continue;
+        }
+        else if (not m_waking and net_wake())
+        {
+            m_waking        = true;
+            m_window_end_us = now_us + net_window_ms() * 1000LL;
+            wait_ms         = net_window_ms();
+        }
+        else if (m_waking and now_us >= m_window_end_us)
+        {
+            // no connection within the window, try again later
+            m_waking = false;
+            m_stats.failures++;
+            publish();
+            m_fails++;
+            m_next_poll_us = now_us + backoff_s(m_fails) * 1000000LL;
+            ESP_LOGW(TAG, "No connection within the radio window");
+            net_sleep();
+            continue;
+        }
+        else if (m_waking)
+            wait_ms = static_cast<uint32_t>((m_window_end_us - now_us) / 1000 + 1);
+
+        ntp_msg_t msg;
+        if (m_queue.receive(&msg, wait_ms))
+            handle(msg);
+    }
+}
@@ -0,0 +1,151 @@
+#include <ctime>
+#include <sys/time.h>
+
+#include "esp_log.h"
+#include "nvs.h"
+
+#include "ds3231.h"
+#include "rtc_source.h"
+#include "timesource.h"
+#include "holdover.h"
+#include "tz.h"
+
+static const char *TAG = "RTC_SOURCE";
+
+static const char *NVS_NAMESPACE = "timer";
+static const char *NVS_KEY       = "rtc_set";
+
+#define RTC_SOURCE_VALID_TIME 1451606400  ///< 2016-01-01, earlier time was never set
+
+static ds3231_t _rtc {
+    .i2c_addr = DS3231_DEFAULT_ADDR,
+    .read     = nullptr,
+    .write    = nullptr,
+};
+
+static rtc_source_stats_t _stats = {};
+
+static int64_t wall_time_us()
+{
+    timeval tv;
+    gettimeofday(&tv, nullptr);
+    return static_cast<int64_t>(tv.tv_sec) * 1000000 + tv.tv_usec;
+}
+
+/**
+ * @brief UTC time of the last RTC write, 0 - unknown
+ */
+static int64_t set_at()
+{
+    nvs_handle_t handle;
+    if (ESP_OK != nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle))
+        return 0;
+
+    int64_t at = 0;
+    if (ESP_OK != nvs_get_i64(handle, NVS_KEY, &at))
+        at = 0;
+    nvs_close(handle);
+    return at;
+}
+
+static void store_set_at(int64_t at)
+{
+    nvs_handle_t handle;
+    if (ESP_OK != nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle))
+    {
+        ESP_LOGE(TAG, "Could not open NVS");
+        return;
+    }
+
+    esp_err_t ret = nvs_set_i64(handle, NVS_KEY, at);
+    if (ret == ESP_OK)
+        ret = nvs_commit(handle);
+    nvs_close(handle);
+
+    if (ret != ESP_OK)
+        ESP_LOGE(TAG, "Could not store RTC write time");
+}
+
+void rtc_source_attach(ds3231_read_t read, ds3231_write_t write) noexcept
+{
+    _rtc.read  = read;
+    _rtc.write = write;
+}
+
+bool rtc_source_restore() noexcept
+{
+    tm utc;
+    ds3231_err_t ret = ds3231_get_time(&_rtc, &utc);
+
+    int64_t now_us = wall_time_us();
+    _stats.present = ret == DS3231_ERR_OK or ret == DS3231_ERR_INVALID;
+    if (ret != DS3231_ERR_OK)
+    {
+        if (not _stats.present)
+            ESP_LOGW(TAG, "No external RTC found");
+        else
+            _stats.failures++;
+        return false;
+    }
+    _stats.reads++;
+
+    int64_t seconds = tz_days_from_civil(utc.tm_year + 1900, utc.tm_mon + 1, utc.tm_mday) * 86400
+                    + utc.tm_hour * 3600 + utc.tm_min * 60 + utc.tm_sec;
+    if (seconds < RTC_SOURCE_VALID_TIME)
+    {
+        ESP_LOGW(TAG, "External RTC was never set");
+        return false;
+    }
+    int64_t rtc_us = seconds * 1000000 + RTC_SOURCE_READ_US;
+    _stats.offset_us = rtc_us - now_us;
+
+    // a TCXO keeps its ppm-level error over the whole time since the last write
+    int64_t uncertainty_us = -1;
+    int64_t at = set_at();
+    if (at and at <= seconds)
+    {
+        int16_t centi = 2500;
+        ds3231_get_temperature(&_rtc, &centi);
+        int64_t ppm = centi >= 0 and centi <= 4000 ? RTC_SOURCE_PPM : RTC_SOURCE_PPM_EXTENDED;
+        uncertainty_us = RTC_SOURCE_READ_US + (seconds - at) * ppm;
+    }
+
+    ESP_LOGI(TAG, "External RTC off by %lld ms, uncertainty %lld ms", (long long)(_stats.offset_us / 1000),
+             (long long)(uncertainty_us < 0 ? -1 : uncertainty_us / 1000));
+    if (not timesource_offer(TIME_SOURCE_RTC, uncertainty_us))
+        return false;
+
+    timeval tv {
+        .tv_sec  = static_cast<time_t>(rtc_us / 1000000),
+        .tv_usec = static_cast<suseconds_t>(rtc_us % 1000000),
+    };
+    settimeofday(&tv, nullptr);
+    if (uncertainty_us >= 0)
+        holdover_synced(uncertainty_us < UINT32_MAX ? static_cast<uint32_t>(uncertainty_us) : UINT32_MAX,
+                        holdover_drift_ppb());
+    return true;
+}
+
+bool rtc_source_save() noexcept
+{
+    if (not _stats.present)
+        return true;
+
+    time_t now = time(nullptr);
+    tm utc;
+    gmtime_r(&now, &utc);
+    if (DS3231_ERR_OK != ds3231_set_time(&_rtc, &utc))
+    {
+        _stats.failures++;
+        return false;
+    }
+
+    _stats.writes++;
+    store_set_at(now);
+    return true;
+}
+
+const rtc_source_stats_t& rtc_source_get_stats() noexcept
+{
+    return _stats;
+}
@@ -0,0 +1,119 @@
+#include "esp_log.h"
+#include "nvs.h"
+
+#include "timesource.h"
+#include "holdover.h"
+
+static const char *TAG = "TIMESOURCE";
+
+static const char *NVS_NAMESPACE = "timer";
+static const char *NVS_KEY       = "sources";
+
+static uint8_t _priority[TIME_SOURCE_NUM] = {
+    [TIME_SOURCE_NONE]     = 0,
+    [TIME_SOURCE_HOLDOVER] = 10,
+    [TIME_SOURCE_RTC]      = 20,
+    [TIME_SOURCE_NTP]      = 30,
+    [TIME_SOURCE_GPS]      = 40,
+};
+
+static time_source_t      _current = TIME_SOURCE_NONE;
+static timesource_stats_t _stats = {};
+
+static bool take(time_source_t source, int64_t uncertainty_us)
+{
+    if (source == _current)
+        return true;
+    if (not _priority[source])
+        return false;
+    if (_current == TIME_SOURCE_NONE)
+        return true;
+
+    int64_t clock_ms = holdover_uncertainty_ms();
+    if (clock_ms < 0)
+        return uncertainty_us >= 0 or _priority[source] > _priority[_current];
+    if (uncertainty_us < 0)
+        return false;
+
+    int64_t clock_us = clock_ms * 1000;
+    if (_priority[source] > _priority[_current])
+        return uncertainty_us <= clock_us + TIMESOURCE_PREFER_US;
+    return uncertainty_us + TIMESOURCE_PREFER_US < clock_us;
+}
+
+bool timesource_offer(time_source_t source, int64_t uncertainty_us) noexcept
+{
+    if (source <= TIME_SOURCE_NONE or source >= TIME_SOURCE_NUM)
+        return false;
+
+    _stats.offers[source]++;
+    if (not take(source, uncertainty_us))
+        return false;
+
+    if (source != _current)
+        ESP_LOGI(TAG, "Time source %s -> %s, uncertainty %lld ms", timesource_name(_current), timesource_name(source),
+                 (long long)(uncertainty_us < 0 ? -1 : uncertainty_us / 1000));
+    _current = source;
+    _stats.taken[source]++;
+    return true;
+}
+
+bool timesource_set_priority(time_source_t source, uint8_t priority) noexcept
+{
+    if (source <= TIME_SOURCE_NONE or source >= TIME_SOURCE_NUM)
+        return false;
+    _priority[source] = priority;
+
+    nvs_handle_t handle;
+    if (ESP_OK != nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle))
+    {
+        ESP_LOGE(TAG, "Could not open NVS");
+        return false;
+    }
+
+    esp_err_t ret = nvs_set_blob(handle, NVS_KEY, _priority, sizeof(_priority));
+    if (ret == ESP_OK)
+        ret = nvs_commit(handle);
+    nvs_close(handle);
+
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Could not store source priorities");
+        return false;
+    }
+    return true;
+}
+
+void timesource_load() noexcept
+{
+    nvs_handle_t handle;
+    if (ESP_OK != nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle))
+        return;
+
+    uint8_t priority[TIME_SOURCE_NUM];
+    size_t  size = sizeof(priority);
+    esp_err_t ret = nvs_get_blob(handle, NVS_KEY, priority, &size);
+    nvs_close(handle);
+
+    // a list from a build with fewer sources keeps the defaults of the new ones
+    if (ret != ESP_OK or size > sizeof(priority))
+        return;
+    for (size_t i = 0; i < size; i++)
+        _priority[i] = priority[i];
+}
+
+time_source_t timesource_current() noexcept
+{
+    return _current;
+}
+
+const char* timesource_name(time_source_t source) noexcept
+{
+    static const char* names[TIME_SOURCE_NUM] = {"none", "holdover", "RTC", "NTP", "GPS"};
+    return source < TIME_SOURCE_NUM ? names[source] : "?";
+}
+
+const timesource_stats_t& timesource_get_stats() noexcept
+{
+    return _stats;
+}
@@ -0,0 +1,255 @@
+#include <cstring>
+#include <cctype>
+
+#include "esp_log.h"
+#include "nvs.h"
+
+#include "tz.h"
+
+static const char *TAG = "TZ";
+
+static const char *NVS_NAMESPACE = "timer";
+static const char *NVS_KEY       = "tz";
+
+static bool is_leap(int year) noexcept
+{
+    return (year % 4 == 0 and year % 100 != 0) or year % 400 == 0;
+}
+
+static int month_days(int mon, int year) noexcept
+{
+    static const uint8_t days[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return days[mon - 1] + (mon == 2 and is_leap(year));
+}
+
+int64_t tz_days_from_civil(int year, int mon, int day) noexcept
+{
+    year -= mon <= 2;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yoe = year - era * 400;
+    int64_t doy = (153 * (mon + (mon > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+static bool parse_name(const char*& str, char* name) noexcept
+{
+    size_t len = 0;
+    if (*str == '<')
+    {
+        for (str++; *str and *str != '>'; str++)
+        {
+            if (len + 1 < TZ_NAME_LEN)
+                name[len++] = *str;
+        }
+        if (*str++ != '>')
+            return false;
+    }
+    else
+    {
+        for (; isalpha(static_cast<unsigned char>(*str)); str++)
+        {
+            if (len + 1 < TZ_NAME_LEN)
+                name[len++] = *str;
+        }
+    }
+    name[len] = '\0';
+    return len >= 3;
+}
+
+static bool parse_number(const char*& str, int32_t& value, int32_t max) noexcept
+{
+    if (not isdigit(static_cast<unsigned char>(*str)))
+        return false;
+
+    value = 0;
+    for (; isdigit(static_cast<unsigned char>(*str)); str++)
+    {
+        value = value * 10 + (*str - '0');
+        if (value > max)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @brief [+-]hh[:mm[:ss]] in seconds
+ */
+static bool parse_time(const char*& str, int32_t& seconds) noexcept
+{
+    int32_t sign = 1;
+    if (*str == '+' or *str == '-')
+        sign = *str++ == '-' ? -1 : 1;
+
+    int32_t hh, mm = 0, ss = 0;
+    if (not parse_number(str, hh, 167))
+        return false;
+    if (*str == ':' and not parse_number(++str, mm, 59))
+        return false;
+    if (*str == ':' and not parse_number(++str, ss, 59))
+        return false;
+
+    seconds = sign * (hh * 3600 + mm * 60 + ss);
+    return true;
+}
+
+static bool parse_date(const char*& str, tz_date_t& date) noexcept
+{
+    int32_t a, b, c;
+    if (*str == 'M')
+    {
+        str++;
+        if (not parse_number(str, a, 12) or *str++ != '.' or not parse_number(str, b, 5) or
+            *str++ != '.' or not parse_number(str, c, 6) or a < 1 or b < 1)
+            return false;
+        date = {tz_date_t::TZ_DATE_MONTH, static_cast<uint8_t>(a), static_cast<uint8_t>(b),
+                static_cast<uint8_t>(c), 0, 7200};
+    }
+    else if (*str == 'J')
+    {
+        str++;
+        if (not parse_number(str, a, 365) or a < 1)
+            return false;
+        date = {tz_date_t::TZ_DATE_JULIAN, 0, 0, 0, static_cast<uint16_t>(a), 7200};
+    }
+    else
+    {
+        if (not parse_number(str, a, 365))
+            return false;
+        date = {tz_date_t::TZ_DATE_YDAY, 0, 0, 0, static_cast<uint16_t>(a), 7200};
+    }
+
+    if (*str == '/')
+        return parse_time(++str, date.time);
+    return true;
+}
+
+bool tz_parse(const char* str, tz_rule_t& rule) noexcept
+{
+    rule = {};
+    if (not str or not parse_name(str, rule.std_name) or not parse_time(str, rule.std_offset))
+        return false;
+
+    // POSIX offsets are west of UTC
+    rule.std_offset = -rule.std_offset;
+    if (not *str)
+        return true;
+
+    rule.has_dst = true;
+    if (not parse_name(str, rule.dst_name))
+        return false;
+
+    rule.dst_offset = rule.std_offset + 3600;
+    if (*str and *str != ',')
+    {
+        if (not parse_time(str, rule.dst_offset))
+            return false;
+        rule.dst_offset = -rule.dst_offset;
+    }
+
+    if (not *str)
+    {
+        // no rule given, POSIX leaves it to the implementation: use the US one like newlib
+        const char* us = ",M3.2.0,M11.1.0";
+        str = us;
+    }
+
+    if (*str++ != ',' or not parse_date(str, rule.start) or *str++ != ',' or not parse_date(str, rule.end))
+        return false;
+    return *str == '\0';
+}
+
+/**
+ * @brief UTC time of a DST change in a year
+ */
+static time_t change_time(const tz_date_t& date, int year, int32_t offset_before) noexcept
+{
+    int64_t days = tz_days_from_civil(year, 1, 1);
+    switch (date.type)
+    {
+        case tz_date_t::TZ_DATE_MONTH:
+        {
+            int64_t first = tz_days_from_civil(year, date.month, 1);
+            int     wday1 = static_cast<int>((first + 4) % 7);  // 1970-01-01 was Thursday
+            int     mday  = 1 + (date.wday - wday1 + 7) % 7 + (date.week - 1) * 7;
+            if (mday > month_days(date.month, year))
+                mday -= 7;
+            days = first + mday - 1;
+            break;
+        }
+        case tz_date_t::TZ_DATE_JULIAN:
+        {
+            days += date.day - 1 + (is_leap(year) and date.day >= 60);
+            break;
+        }
+        case tz_date_t::TZ_DATE_YDAY:
+        {
+            days += date.day;
+            break;
+        }
+    }
+    return static_cast<time_t>(days * 86400 + date.time - offset_before);
+}
+
+void tz_compile(const tz_rule_t& rule, int year, tz_table_t& table) noexcept
+{
+    table.len    = 0;
+    table.from   = static_cast<time_t>(tz_days_from_civil(year, 1, 1) * 86400);
+    table.until  = static_cast<time_t>(tz_days_from_civil(year + TZ_YEARS, 1, 1) * 86400);
+    table.offset = rule.std_offset;
+    table.dst    = false;
+    if (not rule.has_dst)
+        return;
+
+    // southern hemisphere rules start daylight time late in the year and end it early
+    time_t first_start = change_time(rule.start, year, rule.std_offset);
+    time_t first_end   = change_time(rule.end, year, rule.dst_offset);
+    if (first_end < first_start)
+    {
+        table.offset = rule.dst_offset;
+        table.dst    = true;
+    }
+
+    for (int y = year; y < year + TZ_YEARS; y++)
+    {
+        tz_transition_t start {change_time(rule.start, y, rule.std_offset), rule.dst_offset, true};
+        tz_transition_t end   {change_time(rule.end, y, rule.dst_offset), rule.std_offset, false};
+        bool start_first = start.at < end.at;
+        table.transitions[table.len++] = start_first ? start : end;
+        table.transitions[table.len++] = start_first ? end : start;
+    }
+}
+
+bool tz_load(char* str) noexcept
+{
+    nvs_handle_t handle;
+    if (ESP_OK != nvs_open(NVS_NAMESPACE, NVS_READONLY, &handle))
+        return false;
+
+    size_t size = TZ_MAX_LEN;
+    esp_err_t ret = nvs_get_str(handle, NVS_KEY, str, &size);
+    nvs_close(handle);
+    return ret == ESP_OK;
+}
+
+bool tz_save(const char* str) noexcept
+{
+    nvs_handle_t handle;
+    if (ESP_OK != nvs_open(NVS_NAMESPACE, NVS_READWRITE, &handle))
+    {
+        ESP_LOGE(TAG, "Could not open NVS");
+        return false;
+    }
+
+    esp_err_t ret = nvs_set_str(handle, NVS_KEY, str);
+    if (ret == ESP_OK)
+        ret = nvs_commit(handle);
+    nvs_close(handle);
+
+    if (ret != ESP_OK)
+    {
+        ESP_LOGE(TAG, "Could not store timezone");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,44 @@
+#include <chrono>
+#include <cstdlib>
+
+#include "calendar.h"
+#include "test.h"
+
+#define CAL_TICKS 100000
+#define CAL_TZ    "EET-2EEST,M3.5.0/3,M10.5.0/4"  ///< the firmware default
+
+static int64_t elapsed_ns(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+    time_t now = time(nullptr);
+
+    // what every tick cost before the calendar engine
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < CAL_TICKS; i++)
+    {
+        time_t t = now + i;
+        tm     timeinfo;
+        setenv("TZ", CAL_TZ, 1);
+        tzset();
+        localtime_r(&t, &timeinfo);
+    }
+    int64_t legacy_ns = elapsed_ns(start);
+
+    Calendar calendar;
+    calendar.set_tz(CAL_TZ);
+    calendar.advance(now);
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 1; i <= CAL_TICKS; i++)
+        calendar.advance(now + i);
+    int64_t cached_ns = elapsed_ns(start);
+
+    const calendar_stats_t& stats = calendar.get_stats();
+    printf("Calendar: %.1f ns per tick setenv/tzset/localtime_r, %.1f ns calendar; %lu steps, %lu full conversions\n",
+           double(legacy_ns) / CAL_TICKS, double(cached_ns) / CAL_TICKS, (unsigned long)stats.steps,
+           (unsigned long)stats.resets);
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include <cstdlib>
+
+#include "calendar.h"
+#include "test.h"
+
+#define CAL_FROM   1700000000             ///< 2023-11-14
+#define CAL_YEARS  9                      ///< beyond the compiled table, it has to be recompiled
+
+/**
+ * @brief zones with DST in either hemisphere, negative and over 24 h change times, Julian dates
+ */
+static const char* zones[] = {
+    "EET-2EEST,M3.5.0/3,M10.5.0/4",
+    "GMT-3",
+    "<+03>-3",
+    "AEST-10AEDT,M10.1.0,M4.1.0/3",
+    "EST5EDT",
+    "CET-1CEST,M3.5.0,M10.5.0/3",
+    "NZST-12NZDT,M9.5.0,M4.1.0/3",
+    "<-03>3<-02>,M3.5.0/-2,M10.5.0/-1",
+    "IST-2IDT,M3.4.4/26,M10.5.0",
+    "XYZ0ABC,J60/2,300",
+};
+
+static void check(const char* tz)
+{
+    Calendar calendar;
+    if (not calendar.set_tz(tz))
+    {
+        printf("%s: not parsed\n", tz);
+        test_failures++;
+        return;
+    }
+
+    // the calendar applied the zone to libc too, localtime_r is the reference
+    uint32_t mismatches = 0;
+    uint32_t n = 0;
+    for (time_t t = CAL_FROM; t < CAL_FROM + CAL_YEARS * 365L * 86400; n++)
+    {
+        tm ref;
+        localtime_r(&t, &ref);
+        const tm& local = calendar.advance(t);
+        if (ref.tm_sec != local.tm_sec or ref.tm_min != local.tm_min or ref.tm_hour != local.tm_hour or
+            ref.tm_mday != local.tm_mday or ref.tm_mon != local.tm_mon or ref.tm_year != local.tm_year or
+            ref.tm_wday != local.tm_wday or ref.tm_yday != local.tm_yday or ref.tm_isdst != local.tm_isdst)
+        {
+            if (not mismatches++)
+                printf("%s: %02d:%02d at %lld, expected %02d:%02d\n", tz, local.tm_hour, local.tm_min,
+                       (long long)t, ref.tm_hour, ref.tm_min);
+        }
+
+        // ticks of a second, minute boundaries and sleeps of hours
+        t += n % 7 == 0 ? 1 : n % 5 == 0 ? 5 * 3600 : 60;
+    }
+    CHECK_EQ(mismatches, 0);
+}
+
+int main()
+{
+    for (const char* tz: zones)
+        check(tz);
+
+    printf("%s\n", test_failures ? "FAILED" : "OK");
+    return test_failures ? 1 : 0;
+}
@@ -0,0 +1,60 @@
+#include <chrono>
+
+#include "nixie.h"
+#include "test.h"
+
+int main()
+{
+    // the board's own table and layout
+    static constexpr auto lut = nixie_desc.lut();
+    std::span<const lamp_lut_t> lamps {lut};
+
+    dial_frame_t frame = {};
+    uint8_t  ports[DIAL_PORT_NUM] = {};
+    uint32_t before = 0;
+    uint32_t after  = 0;
+    uint32_t bursts = 0;
+    uint32_t lamps_changed = 0;
+    auto start = std::chrono::steady_clock::now();
+
+    // a day of minute updates
+    tm time = {};
+    time.tm_mday = 1;
+    time.tm_year = 124;
+    for (int minute = 0; minute < 24 * 60; minute++)
+    {
+        time.tm_hour = minute / 60;
+        time.tm_min  = minute % 60;
+
+        uint16_t fields[DIAL_FIELD_NUM];
+        dial_fields(time, nixie_layout.flags, true, fields);
+        uint8_t changed = dial_render(frame, lamps, nixie_layout, fields);
+
+        // the original path read and wrote a port for every lamp on every update
+        before += 2 * lamps.size();
+        for (; changed; changed &= changed - 1)
+            lamps_changed++;
+
+        bool dirty = false;
+        for (uint8_t port = 0; port < DIAL_PORT_NUM; port++)
+        {
+            if (minute and ports[port] == frame.ports[port])
+                continue;
+            ports[port] = frame.ports[port];
+            after++;
+            dirty = true;
+        }
+        bursts += dirty;
+    }
+    auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    printf("Day of minute updates: %lu transactions before, %lu port writes in %lu bursts after, "
+           "%lu lamps changed, %lld ns\n", (unsigned long)before, (unsigned long)after, (unsigned long)bursts,
+           (unsigned long)lamps_changed, (long long)elapsed_ns);
+
+    // every minute changes the last digit, the dial ends at 23:59
+    CHECK_EQ(bursts, 24 * 60);
+    CHECK(after < before);
+    CHECK(frame.values[0] == 2 and frame.values[1] == 3 and frame.values[2] == 5 and frame.values[3] == 9);
+    return test_failures ? 1 : 0;
+}
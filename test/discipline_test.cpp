@@ -0,0 +1,76 @@
+#include "discipline.h"
+#include "test.h"
+
+#define SIM_TICK_US    (60 * 1000000LL)         ///< discipline_tick runs every boundary of a minute
+#define SIM_RUN_US     (48 * 3600 * 1000000LL)
+#define SIM_SETTLE_US  (12 * 3600 * 1000000LL)  ///< errors before this are the filter settling
+#define SIM_DRIFT_PPB  23000                    ///< crystal 23 ppm fast
+#define SIM_JITTER_US  5000                     ///< SNTP offset noise
+
+static int64_t abs64(int64_t value)
+{
+    return value < 0 ? -value : value;
+}
+
+/**
+ * @brief run the filter against a simulated clock with drift and jitter
+ *
+ * @param [in]  interval_s sync interval
+ * @param [out] drift_ppb  final drift estimate
+ *
+ * @return largest clock error after settling
+ */
+static int64_t simulate(uint32_t interval_s, int32_t& drift_ppb)
+{
+    Discipline discipline;
+    uint32_t   seed = 1;
+    int64_t    error_us = 0;  // clock minus true time
+    int64_t    max_us = 0;
+    int64_t    next_sync_us = 0;
+
+    for (int64_t t = 0; t < SIM_RUN_US; t += SIM_TICK_US)
+    {
+        if (t >= next_sync_us)
+        {
+            seed = seed * 1664525u + 1013904223u;
+            int64_t jitter = static_cast<int64_t>(seed >> 8) % (2 * SIM_JITTER_US + 1) - SIM_JITTER_US;
+            if (discipline.sample(-error_us + jitter, t))
+                error_us = -jitter;
+            next_sync_us = t + interval_s * 1000000LL;
+        }
+
+        error_us += SIM_DRIFT_PPB * SIM_TICK_US / 1000000000LL + discipline.tick(SIM_TICK_US);
+        if (t >= SIM_SETTLE_US)
+            max_us = abs64(error_us) > max_us ? abs64(error_us) : max_us;
+    }
+    drift_ppb = discipline.drift_ppb();
+    return max_us;
+}
+
+int main()
+{
+    static const uint32_t intervals[] = {64, 256, 1024, 4096, 16384};
+    for (uint32_t interval_s: intervals)
+    {
+        int32_t drift_ppb;
+        int64_t max_us = simulate(interval_s, drift_ppb);
+        printf("Sync every %5lu s: max error %lld us, drift %ld ppb of %d\n",
+               (unsigned long)interval_s, (long long)max_us, (long)drift_ppb, SIM_DRIFT_PPB);
+
+        // the jitter of one sample at most, wherever the drift left the clock
+        CHECK(max_us <= 2 * SIM_JITTER_US);
+        // jitter spread over a long interval hardly disturbs the estimate
+        if (interval_s >= 1024)
+            CHECK(abs64(drift_ppb - SIM_DRIFT_PPB) <= SIM_DRIFT_PPB / 10);
+    }
+
+    // an offset beyond DISCIPLINE_STEP_US is stepped, not slewed
+    Discipline discipline;
+    CHECK(discipline.sample(DISCIPLINE_STEP_US + 1, 0));
+    CHECK_EQ(discipline.tick(SIM_TICK_US), 0);
+    CHECK(not discipline.sample(1000, SIM_TICK_US));
+    CHECK_EQ(discipline.get_stats().steps, 1);
+
+    printf("%s\n", test_failures ? "FAILED" : "OK");
+    return test_failures ? 1 : 0;
+}
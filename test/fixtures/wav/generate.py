@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""Writes the WAV fixtures and the DAC samples they decode to (.dac, one unsigned byte per sample)."""
+
+import math
+import struct
+
+STEP = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+]
+INDEX = [-1, -1, -1, -1, 2, 4, 6, 8] * 2
+
+
+def tone(rate, seconds, amplitude=20000):
+    """Decaying two-partial bell, so the ADPCM step size moves both ways."""
+    n = int(rate * seconds)
+    return [int(amplitude * math.exp(-3 * i / n) *
+                (0.7 * math.sin(2 * math.pi * 880 * i / rate) + 0.3 * math.sin(2 * math.pi * 2217 * i / rate)))
+            for i in range(n)]
+
+
+def adpcm(samples, block_align):
+    """IMA ADPCM encoder, returns the data and what a decoder reconstructs."""
+    per_block = (block_align - 4) * 2 + 1
+    data, decoded = b'', []
+    for start in range(0, len(samples), per_block):
+        block = samples[start:start + per_block]
+        predictor, index = block[0], 0
+        data += struct.pack('<hBB', predictor, index, 0)
+        decoded.append(predictor)
+        codes = []
+        for sample in block[1:]:
+            step = STEP[index]
+            delta, code, diff = sample - predictor, 0, step >> 3
+            if delta < 0:
+                code, delta = 8, -delta
+            if delta >= step:
+                code, delta, diff = code | 4, delta - step, diff + step
+            if delta >= step >> 1:
+                code, delta, diff = code | 2, delta - (step >> 1), diff + (step >> 1)
+            if delta >= step >> 2:
+                code, diff = code | 1, diff + (step >> 2)
+            predictor = max(-32768, min(32767, predictor - diff if code & 8 else predictor + diff))
+            index = max(0, min(88, index + INDEX[code]))
+            codes.append(code)
+            decoded.append(predictor)
+        # a short last block is padded to whole bytes
+        if len(codes) % 2:
+            codes.append(0)
+        data += bytes(codes[i] | codes[i + 1] << 4 for i in range(0, len(codes), 2))
+    return data, decoded
+
+
+def wav(fmt, rate, bits, block_align, data, per_block=0):
+    fmt_chunk = struct.pack('<HHIIHH', fmt, 1, rate, rate * block_align // (per_block or 1), block_align, bits)
+    if per_block:
+        fmt_chunk += struct.pack('<HH', 2, per_block)
+    # a LIST chunk of odd size before the data, the parser has to skip it word aligned
+    body = (b'WAVE' + b'fmt ' + struct.pack('<I', len(fmt_chunk)) + fmt_chunk +
+            b'LIST' + struct.pack('<I', 3) + b'abc\0' + b'data' + struct.pack('<I', len(data)) + data)
+    if len(data) % 2:
+        body += b'\0'
+    return b'RIFF' + struct.pack('<I', len(body)) + body
+
+
+def save(name, file, dac):
+    with open(name + '.wav', 'wb') as out:
+        out.write(file)
+    with open(name + '.dac', 'wb') as out:
+        out.write(bytes(dac))
+
+
+def main():
+    samples = tone(16000, 0.25)
+    data, decoded = adpcm(samples, 256)
+    save('bell_adpcm', wav(0x11, 16000, 4, 256, data, (256 - 4) * 2 + 1), [(s >> 8) + 128 for s in decoded])
+
+    samples = tone(16000, 0.1)
+    save('bell_pcm16', wav(1, 16000, 16, 2, b''.join(struct.pack('<h', s) for s in samples)),
+         [(s >> 8) + 128 for s in samples])
+
+    # odd sample count, the file ends on a pad byte
+    samples = [(s >> 8) + 128 for s in tone(8000, 0.1)][:-1]
+    save('bell_pcm8', wav(1, 8000, 8, 1, bytes(samples)), samples)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,35 @@
+#include <chrono>
+
+#include "nmea.h"
+#include "test.h"
+
+#define NMEA_ROUNDS 10000
+#define NMEA_CHUNK  64     ///< a UART read rarely returns more
+
+int main()
+{
+    std::string data  = fixture("nmea/ublox_fix.nmea");
+    const auto* bytes = reinterpret_cast<const uint8_t*>(data.data());
+
+    Nmea     nmea;
+    uint32_t fixes = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < NMEA_ROUNDS; r++)
+    {
+        for (size_t off = 0; off < data.size();)
+        {
+            size_t n = data.size() - off < NMEA_CHUNK ? data.size() - off : NMEA_CHUNK;
+            bool ready;
+            off += nmea.parse({bytes + off, n}, ready);
+            fixes += ready;
+        }
+    }
+    auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    const nmea_stats_t& stats = nmea.get_stats();
+    printf("NMEA: %lu bytes in %lld us, %.1f MB/s, %.2f ns/byte; %lu fixes, %lu sentences, %lu errors\n",
+           (unsigned long)stats.bytes, (long long)(elapsed_ns / 1000), stats.bytes * 1000.0 / elapsed_ns,
+           double(elapsed_ns) / stats.bytes, (unsigned long)fixes, (unsigned long)stats.sentences,
+           (unsigned long)stats.errors);
+    return stats.errors ? 1 : 0;
+}
@@ -0,0 +1,71 @@
+#include <cstring>
+#include <vector>
+
+#include "nmea.h"
+#include "test.h"
+
+/**
+ * @brief recorded receiver output and the fixes it holds
+ */
+static const char* recordings[] = {
+    "nmea/ublox_fix",    ///< five seconds of a receiver with a fix
+    "nmea/cold_start",   ///< no time, time without fix, a corrupted and a truncated sentence, then a fix
+};
+
+static void check(const char* name, size_t chunk)
+{
+    std::string data   = fixture((std::string(name) + ".nmea").c_str());
+    std::istringstream expect(fixture((std::string(name) + ".expect").c_str()));
+
+    Nmea nmea;
+    std::vector<nmea_fix_t> fixes;
+    const auto* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    for (size_t off = 0; off < data.size();)
+    {
+        // a chunk may end anywhere, the parser returns early after a fix
+        size_t n = data.size() - off < chunk ? data.size() - off : chunk;
+        bool ready;
+        off += nmea.parse({bytes + off, n}, ready);
+        if (ready)
+            fixes.push_back(nmea.fix());
+    }
+
+    size_t      num = 0;
+    std::string what;
+    while (expect >> what)
+    {
+        if (what == "errors")
+        {
+            long long errors;
+            expect >> errors;
+            CHECK_EQ(nmea.get_stats().errors, errors);
+            continue;
+        }
+
+        long long utc, utc_us, valid;
+        expect >> utc >> utc_us >> valid;
+        if (num >= fixes.size())
+        {
+            printf("%s, chunk %zu: fix %zu missing\n", name, chunk, num);
+            test_failures++;
+            return;
+        }
+        CHECK_EQ(fixes[num].utc, utc);
+        CHECK_EQ(fixes[num].utc_us, utc_us);
+        CHECK_EQ(fixes[num].valid, valid);
+        num++;
+    }
+    CHECK_EQ(fixes.size(), num);
+    CHECK_EQ(nmea.get_stats().bytes, data.size());
+    CHECK_EQ(nmea.get_stats().fixes, num);
+}
+
+int main()
+{
+    for (const char* name: recordings)
+        for (size_t chunk: {1, 2, 7, 64, 4096})
+            check(name, chunk);
+
+    printf("%s\n", test_failures ? "FAILED" : "OK");
+    return test_failures ? 1 : 0;
+}
@@ -0,0 +1,11 @@
+#ifndef EXPERIMENTS_TEST_ESP_CPU_H
+#define EXPERIMENTS_TEST_ESP_CPU_H
+
+#include <cstdint>
+
+/**
+ * @brief host nanoseconds, benchmarks report them as cycles of a 1 GHz core
+ */
+uint32_t esp_cpu_get_cycle_count();
+
+#endif //EXPERIMENTS_TEST_ESP_CPU_H
@@ -0,0 +1,10 @@
+#ifndef EXPERIMENTS_TEST_ESP_ERR_H
+#define EXPERIMENTS_TEST_ESP_ERR_H
+
+typedef int esp_err_t;
+
+#define ESP_OK                 0
+#define ESP_FAIL              -1
+#define ESP_ERR_NVS_NOT_FOUND  0x1102
+
+#endif //EXPERIMENTS_TEST_ESP_ERR_H
@@ -0,0 +1,11 @@
+#ifndef EXPERIMENTS_TEST_ESP_TIMER_H
+#define EXPERIMENTS_TEST_ESP_TIMER_H
+
+#include <cstdint>
+
+/**
+ * @brief monotonic time in microseconds
+ */
+int64_t esp_timer_get_time();
+
+#endif //EXPERIMENTS_TEST_ESP_TIMER_H
@@ -0,0 +1,25 @@
+#ifndef EXPERIMENTS_TEST_NVS_H
+#define EXPERIMENTS_TEST_NVS_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include "esp_err.h"
+
+/**
+ * @brief empty storage, every read finds nothing and every write is dropped
+ */
+typedef uint32_t nvs_handle_t;
+
+enum nvs_open_mode_t {
+    NVS_READONLY,
+    NVS_READWRITE,
+};
+
+esp_err_t nvs_open(const char* name, nvs_open_mode_t mode, nvs_handle_t* handle);
+esp_err_t nvs_get_str(nvs_handle_t handle, const char* key, char* value, size_t* length);
+esp_err_t nvs_set_str(nvs_handle_t handle, const char* key, const char* value);
+esp_err_t nvs_commit(nvs_handle_t handle);
+void      nvs_close(nvs_handle_t handle);
+
+#endif //EXPERIMENTS_TEST_NVS_H
@@ -0,0 +1,42 @@
+#include <chrono>
+
+#include "nvs.h"
+#include "esp_timer.h"
+#include "esp_cpu.h"
+
+esp_err_t nvs_open(const char*, nvs_open_mode_t, nvs_handle_t* handle)
+{
+    *handle = 0;
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_str(nvs_handle_t, const char*, char*, size_t*)
+{
+    return ESP_ERR_NVS_NOT_FOUND;
+}
+
+esp_err_t nvs_set_str(nvs_handle_t, const char*, const char*)
+{
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t)
+{
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t)
+{
+}
+
+int64_t esp_timer_get_time()
+{
+    using namespace std::chrono;
+    return duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+uint32_t esp_cpu_get_cycle_count()
+{
+    using namespace std::chrono;
+    return static_cast<uint32_t>(duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count());
+}
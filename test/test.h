@@ -0,0 +1,52 @@
+#ifndef EXPERIMENTS_TEST_H
+#define EXPERIMENTS_TEST_H
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <fstream>
+#include <sstream>
+
+/**
+ * @brief failed checks of the test, the exit status
+ */
+inline int test_failures = 0;
+
+#define CHECK(cond)                                                         \
+    do {                                                                    \
+        if (not (cond))                                                     \
+        {                                                                   \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            test_failures++;                                                \
+        }                                                                   \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                            \
+    do {                                                                                      \
+        long long _a = (actual), _e = (expected);                                             \
+        if (_a != _e)                                                                         \
+        {                                                                                     \
+            printf("%s:%d: %s is %lld, expected %lld\n", __FILE__, __LINE__, #actual, _a, _e); \
+            test_failures++;                                                                  \
+        }                                                                                     \
+    } while (0)
+
+/**
+ * @brief read a fixture, FIXTURES is the fixture directory given by CMake
+ *
+ * @param [in] name path below the fixture directory
+ */
+inline std::string fixture(const char* name)
+{
+    std::ifstream file(std::string(FIXTURES) + "/" + name, std::ios::binary);
+    if (not file)
+    {
+        printf("Missing fixture %s\n", name);
+        exit(2);
+    }
+    std::stringstream data;
+    data << file.rdbuf();
+    return data.str();
+}
+
+#endif //EXPERIMENTS_TEST_H
@@ -0,0 +1,55 @@
+#include <chrono>
+
+#include "wav.h"
+#include "test.h"
+
+#define WAV_ROUNDS  200
+#define WAV_SAMPLES 512    ///< samples of a DAC DMA buffer, as the chime player decodes them
+
+static void benchmark(const char* name)
+{
+    std::string file = fixture(name);
+    wav_info_t  wav {};
+    if (not wav_parse(reinterpret_cast<const uint8_t*>(file.data()), file.size(), wav))
+    {
+        printf("%s: not a supported WAV\n", name);
+        test_failures++;
+        return;
+    }
+
+    static uint8_t buf[WAV_SAMPLES];
+    uint64_t samples = 0;
+    int64_t  max_ns = 0;
+    uint32_t buffers = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < WAV_ROUNDS; r++)
+    {
+        WavDecoder decoder;
+        decoder.begin(wav);
+        while (1)
+        {
+            auto   begin = std::chrono::steady_clock::now();
+            size_t len   = decoder.decode(buf, WAV_SAMPLES);
+            int64_t spent = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+            if (not len)
+                break;
+            buffers++;
+            samples += len;
+            max_ns = spent > max_ns ? spent : max_ns;
+        }
+    }
+    auto elapsed_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+    // decode time against the playback time of the same samples
+    double audio_ns = samples * 1e9 / wav.rate_hz;
+    printf("%s: %s %u bit %lu Hz; %.0f ns per buffer, max %lld; %.2f ns per sample, %.4f%% of playback\n",
+           name, wav.format == WAV_FORMAT_IMA_ADPCM ? "ADPCM" : "PCM", wav.bits, (unsigned long)wav.rate_hz,
+           double(elapsed_ns) / buffers, (long long)max_ns, double(elapsed_ns) / samples, elapsed_ns * 100.0 / audio_ns);
+}
+
+int main()
+{
+    for (const char* name: {"wav/bell_adpcm.wav", "wav/bell_pcm16.wav", "wav/bell_pcm8.wav"})
+        benchmark(name);
+    return test_failures ? 1 : 0;
+}
@@ -0,0 +1,106 @@
+#include <cstring>
+#include <vector>
+
+#include "wav.h"
+#include "test.h"
+
+struct recording_t {
+    const char* name;
+    uint16_t    format;
+    uint16_t    bits;
+    uint32_t    rate_hz;
+};
+
+/**
+ * @brief WAV fixtures and the DAC samples they decode to, see fixtures/wav/generate.py
+ */
+static const recording_t recordings[] = {
+    {"wav/bell_adpcm", WAV_FORMAT_IMA_ADPCM, 4,  16000},
+    {"wav/bell_pcm16", WAV_FORMAT_PCM,       16, 16000},
+    {"wav/bell_pcm8",  WAV_FORMAT_PCM,       8,  8000},
+};
+
+static std::string load(const recording_t& rec, const char* ext)
+{
+    return fixture((std::string(rec.name) + ext).c_str());
+}
+
+static void check_decode(const recording_t& rec)
+{
+    std::string file = load(rec, ".wav");
+    std::string dac  = load(rec, ".dac");
+
+    wav_info_t wav {};
+    CHECK_EQ(wav_parse(reinterpret_cast<const uint8_t*>(file.data()), file.size(), wav), file.size());
+    CHECK_EQ(wav.format, rec.format);
+    CHECK_EQ(wav.bits, rec.bits);
+    CHECK_EQ(wav.rate_hz, rec.rate_hz);
+
+    // decoding resumes anywhere, mid ADPCM block too
+    for (size_t chunk: {1, 7, 505, 512, 100000})
+    {
+        WavDecoder decoder;
+        decoder.begin(wav);
+
+        std::vector<uint8_t> out;
+        std::vector<uint8_t> buf(chunk);
+        while (size_t len = decoder.decode(buf.data(), chunk))
+            out.insert(out.end(), buf.begin(), buf.begin() + len);
+
+        CHECK_EQ(out.size(), dac.size());
+        CHECK(out.size() == dac.size() and not memcmp(out.data(), dac.data(), out.size()));
+    }
+}
+
+static void check_image()
+{
+    // a chimes partition: files back to back, erased flash after them
+    std::string image;
+    for (const auto& rec: recordings)
+        image += load(rec, ".wav");
+    image += std::string(64, '\xff');
+
+    const auto* data = reinterpret_cast<const uint8_t*>(image.data());
+    size_t num = 0;
+    for (size_t pos = 0; pos < image.size();)
+    {
+        wav_info_t wav {};
+        size_t len = wav_parse(data + pos, image.size() - pos, wav);
+        if (not len)
+            break;
+        CHECK_EQ(wav.rate_hz, recordings[num].rate_hz);
+        pos += len;
+        num++;
+    }
+    CHECK_EQ(num, sizeof(recordings) / sizeof(recordings[0]));
+}
+
+static void check_rejected()
+{
+    std::string file = load(recordings[1], ".wav");
+    wav_info_t  wav {};
+
+    // stereo
+    std::string stereo = file;
+    stereo[22] = 2;
+    CHECK_EQ(wav_parse(reinterpret_cast<const uint8_t*>(stereo.data()), stereo.size(), wav), 0);
+
+    // 24 bit PCM
+    std::string wide = file;
+    wide[34] = 24;
+    CHECK_EQ(wav_parse(reinterpret_cast<const uint8_t*>(wide.data()), wide.size(), wav), 0);
+
+    // cut within the data chunk header
+    CHECK_EQ(wav_parse(reinterpret_cast<const uint8_t*>(file.data()), 40, wav), 0);
+}
+
+int main()
+{
+    for (const auto& rec: recordings)
+        check_decode(rec);
+    check_image();
+    check_rejected();
+
+    printf("%s\n", test_failures ? "FAILED" : "OK");
+    return test_failures ? 1 : 0;
+}
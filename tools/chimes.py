@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""Packs WAV files into the image of the chimes partition.
+
+Chime ids follow the order of the files. The firmware walks the image file by file and stops at the
+first bytes that aren't a supported WAV, so only files it can play are accepted: mono 8/16 bit PCM or
+4 bit IMA ADPCM.
+
+    tools/chimes.py -o build/chimes.bin chimes/*.wav
+"""
+
+import argparse
+import csv
+import os
+import struct
+import sys
+
+WAV_FORMAT_PCM = 1
+WAV_FORMAT_IMA_ADPCM = 0x11
+CHIME_MAX = 8                  # chime.h
+CHIME_PARTITION = 'chimes'     # chime.h
+
+
+def check(name, data):
+    """Returns the file padded as the firmware steps over it, raises ValueError if it can't play it."""
+    if len(data) < 12 or data[0:4] != b'RIFF' or data[8:12] != b'WAVE':
+        raise ValueError('not a RIFF WAV file')
+    total = struct.unpack_from('<I', data, 4)[0] + 8
+    if total > len(data):
+        raise ValueError('truncated, RIFF size %d of %d bytes' % (total, len(data)))
+
+    fmt = None
+    pos = 12
+    while pos + 8 <= total:
+        chunk, size = data[pos:pos + 4], struct.unpack_from('<I', data, pos + 4)[0]
+        if chunk == b'fmt ' and size >= 16:
+            fmt = struct.unpack_from('<HHIIHH', data, pos + 8)
+        elif chunk == b'data':
+            if not fmt:
+                raise ValueError('data before format')
+            format_tag, channels, rate, _, block_align, bits = fmt
+            pcm = format_tag == WAV_FORMAT_PCM and bits in (8, 16)
+            adpcm = format_tag == WAV_FORMAT_IMA_ADPCM and bits == 4 and block_align > 4
+            if channels != 1 or not (pcm or adpcm) or not rate:
+                raise ValueError('format %#x, %d channels, %d bit; mono 8/16 bit PCM or IMA ADPCM needed'
+                                 % (format_tag, channels, bits))
+            print('%s: %s %d bit %d Hz, %.2f s' % (name, 'ADPCM' if adpcm else 'PCM', bits, rate,
+                  (size * 2 if adpcm else size // (bits // 8)) / rate))
+            # RIFF chunks are word aligned, so is the next file
+            return data[:total] + b'\0' * (total & 1)
+        pos += 8 + size + (size & 1)
+    raise ValueError('no data chunk')
+
+
+def partition_size(table):
+    with open(table, newline='') as file:
+        for row in csv.reader(line for line in file if not line.lstrip().startswith('#')):
+            if row and row[0].strip() == CHIME_PARTITION:
+                return int(row[4].strip(), 0)
+    raise ValueError('no %s partition in %s' % (CHIME_PARTITION, table))
+
+
+def main():
+    root = os.path.join(os.path.dirname(os.path.abspath(__file__)), os.pardir)
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('wav', nargs='+', help='chimes in id order')
+    parser.add_argument('-o', '--output', required=True, help='image to write')
+    parser.add_argument('--partitions', default=os.path.join(root, 'partitions.csv'),
+                        help='partition table the image has to fit')
+    args = parser.parse_args()
+
+    if len(args.wav) > CHIME_MAX:
+        sys.exit('%d chimes, the firmware plays %d at most' % (len(args.wav), CHIME_MAX))
+
+    image = b''
+    for name in args.wav:
+        with open(name, 'rb') as file:
+            try:
+                image += check(name, file.read())
+            except ValueError as err:
+                sys.exit('%s: %s' % (name, err))
+
+    size = partition_size(args.partitions)
+    if len(image) > size:
+        sys.exit('image takes %d bytes, the partition %d' % (len(image), size))
+
+    # erased flash after the last file ends the walk
+    with open(args.output, 'wb') as file:
+        file.write(image)
+    print('%d chimes, %d of %d bytes' % (len(args.wav), len(image), size))
+
+
+if __name__ == '__main__':
+    main()
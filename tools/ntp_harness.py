@@ -0,0 +1,195 @@
+#!/usr/bin/env python3
+"""Syncs a board against tools/ntp_responder.py and checks the offsets it measures.
+
+Runs the responder on this host, points the board at it through the serial console (`servers`), then
+asks for a poll (`sync`) every round and reads the offsets the NTP task logs. The first replies step
+the board onto the responder's clock; the offsets after them should stay within --tolerance-ms. With
+--watch-s the board then polls on its own for that long, its requests give the packets per day. The
+default servers are set again at the end. Needs pyserial.
+
+Reports time to first sync (from `servers` to the first answered poll), steady state offset and packets
+per day, along with the board's own figures when its NTP report shows up in the log.
+
+    tools/ntp_harness.py --serial /dev/ttyUSB0 --host-ip 192.168.1.20 --offset-ms 250 --jitter-ms 5 --loss 0.2
+"""
+
+import argparse
+import os
+import re
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import ntp_responder  # noqa: E402
+
+NTP_DEFAULT_SERVERS = 'pool.ntp.org,time.google.com,time.cloudflare.com'   # ntp.h
+NTP_OFFSET = re.compile(r'NTP: (\S+): offset (-?\d+) us, rtt (\d+) us')
+NTP_FAILED = re.compile(r'NTP: No server answered')
+NTP_STATS = re.compile(r'NTP: First sync after (-?\d+) ms, steady offset (-?\d+) us over (\d+) syncs, '
+                       r'(\d+) packets per day')
+
+
+class Console:
+    """Commands to the board and lines back, the UART sleeps until a few bytes wake it."""
+
+    def __init__(self, port, baud, echo):
+        import serial
+        self.serial = serial.Serial(port, baud, timeout=0.1)
+        self.echo = echo
+        self.pending = b''
+
+    def command(self, line):
+        self.serial.write(b'\n')     # only wakes the chip
+        self.serial.flush()
+        time.sleep(0.2)
+        self.serial.write(line.encode() + b'\n')
+        self.serial.flush()
+
+    def lines(self, timeout):
+        deadline = time.monotonic() + timeout
+        while time.monotonic() < deadline:
+            self.pending += self.serial.read(256)
+            while b'\n' in self.pending:
+                line, self.pending = self.pending.split(b'\n', 1)
+                line = line.decode(errors='replace').rstrip()
+                if self.echo:
+                    print('  | ' + line)
+                yield line
+
+    def close(self):
+        self.serial.close()
+
+
+class Board:
+    """The figures the board reports, filled in from any line read."""
+
+    def __init__(self):
+        self.stats = None
+
+    def parse(self, line):
+        match = NTP_STATS.search(line)
+        if match:
+            self.stats = tuple(int(group) for group in match.groups())
+
+
+def wait_round(console, board, timeout):
+    """Returns (offset_us, rtt_us) of the next poll, None if it failed or timed out."""
+    for line in console.lines(timeout):
+        board.parse(line)
+        match = NTP_OFFSET.search(line)
+        if match:
+            return int(match.group(2)), int(match.group(3))
+        if NTP_FAILED.search(line):
+            return None
+    return None
+
+
+def watch(console, board, duration):
+    """Returns the offsets of the polls the board makes on its own within duration seconds."""
+    offsets = []
+    for line in console.lines(duration):
+        board.parse(line)
+        match = NTP_OFFSET.search(line)
+        if match:
+            offsets.append(int(match.group(2)))
+    return offsets
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--serial', required=True, help='serial port of the board')
+    parser.add_argument('--baud', type=int, default=115200, help='default %(default)s')
+    parser.add_argument('--host-ip', required=True, help='address of this host as the board reaches it')
+    parser.add_argument('--rounds', type=int, default=10, help='polls to measure, default %(default)s')
+    parser.add_argument('--settle', type=int, default=2, help='first answered polls not checked, default %(default)s')
+    parser.add_argument('--timeout', type=float, default=30.0, help='seconds to wait for a poll, default %(default)s')
+    parser.add_argument('--tolerance-ms', type=float, default=None,
+                        help='largest offset after settling, default jitter plus delay asymmetry plus 5 ms')
+    parser.add_argument('--watch-s', type=float, default=0.0,
+                        help='seconds to let the board poll on its own afterwards, default %(default)s')
+    parser.add_argument('--restore', default=NTP_DEFAULT_SERVERS, help='servers set at the end, default ntp.h')
+    parser.add_argument('--echo', action='store_true', help='print the board log')
+    ntp_responder.add_arguments(parser)
+    args = parser.parse_args()
+
+    tolerance_ms = args.tolerance_ms
+    if tolerance_ms is None:
+        tolerance_ms = args.jitter_ms + abs(args.asymmetry - 0.5) * args.delay_ms + 5
+
+    try:
+        server = ntp_responder.responder(args)
+    except (ValueError, OSError) as e:
+        print('ntp_harness: %s' % e, file=sys.stderr)
+        return 1
+    server.start()
+
+    try:
+        console = Console(args.serial, args.baud, args.echo)
+    except Exception as e:
+        print('ntp_harness: %s' % e, file=sys.stderr)
+        return 1
+
+    board = Board()
+    answered = []
+    watched = []
+    failed = 0
+    first_sync_s = None
+    watched_requests = 0
+    watched_s = 0.0
+    try:
+        started = time.monotonic()
+        console.command('servers %s:%d' % (args.host_ip, server.port))
+        for i in range(args.rounds):
+            if i:
+                console.command('sync')
+            result = wait_round(console, board, args.timeout)
+            if result is None:
+                failed += 1
+                print('%3d  no answer' % i)
+                continue
+            if first_sync_s is None:
+                first_sync_s = time.monotonic() - started
+            answered.append(result)
+            print('%3d  offset %9.3f ms  rtt %7.3f ms%s'
+                  % (i, result[0] / 1000, result[1] / 1000, '  settling' if len(answered) <= args.settle else ''))
+        if args.watch_s > 0:
+            # no more forced polls, the requests from here on are the board's own schedule
+            requests = server.requests
+            watch_started = time.monotonic()
+            watched = watch(console, board, args.watch_s)
+            watched_s = time.monotonic() - watch_started
+            watched_requests = server.requests - requests
+    except KeyboardInterrupt:
+        pass
+    finally:
+        console.command('servers %s' % args.restore)
+        console.close()
+        server.stop()
+
+    steady = [offset for offset, _ in answered[args.settle:]] + watched
+    print('%d requests, %d dropped, %d polls answered, %d failed'
+          % (server.requests, server.dropped, len(answered) + len(watched), failed))
+    if first_sync_s is not None:
+        print('first sync after %.1f s' % first_sync_s)
+    if watched_s > 0:
+        print('%d requests in %.0f s on its own, %.0f packets per day'
+              % (watched_requests, watched_s, watched_requests * 86400 / watched_s))
+    else:
+        print('packets per day not measured, polls were forced; use --watch-s')
+    if board.stats:
+        print('board: first sync after %d ms, steady offset %d us over %d syncs, %d packets per day' % board.stats)
+    if not steady:
+        print('FAIL: no poll answered after settling')
+        return 1
+    worst_ms = max(abs(offset) for offset in steady) / 1000
+    mean_ms = sum(steady) / len(steady) / 1000
+    print('steady offset mean %.3f ms, worst %.3f ms, tolerance %.3f ms' % (mean_ms, worst_ms, tolerance_ms))
+    if worst_ms > tolerance_ms:
+        print('FAIL')
+        return 1
+    print('PASS')
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
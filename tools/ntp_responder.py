@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+"""Answers SNTP queries from the host clock with a controllable error.
+
+Replies are shifted by a fixed offset, held back by a network delay that jitters and splits unevenly
+between the two directions, and dropped at random. The offset a client measures is off by half the
+difference of the two directions, so with --asymmetry 0.5 it should settle on --offset-ms within the
+jitter.
+
+    tools/ntp_responder.py --port 12300 --offset-ms 250 --delay-ms 40 --jitter-ms 10 --loss 0.2
+"""
+
+import argparse
+import random
+import socket
+import struct
+import sys
+import threading
+import time
+
+NTP_PACKET_LEN = 48
+NTP_UNIX_OFFSET = 2208988800   # seconds from 1900 to 1970
+NTP_MODE_CLIENT = 3
+NTP_MODE_SERVER = 4
+
+
+def to_ntp(t):
+    """Packs a unix time in seconds as a 64 bit NTP timestamp."""
+    seconds = int(t)
+    return struct.pack('!II', (seconds + NTP_UNIX_OFFSET) & 0xffffffff, int((t - seconds) * 2**32) & 0xffffffff)
+
+
+class Responder:
+    """SNTP server on a UDP socket, serve() answers until stop()."""
+
+    def __init__(self, host='0.0.0.0', port=12300, offset_ms=0.0, delay_ms=0.0, jitter_ms=0.0,
+                 asymmetry=0.5, loss=0.0, stratum=2, log=None):
+        self.offset = offset_ms / 1000
+        self.delay = delay_ms / 1000
+        self.jitter = jitter_ms / 1000
+        self.asymmetry = asymmetry
+        self.loss = loss
+        self.stratum = stratum
+        self.log = log
+        self.requests = 0
+        self.dropped = 0
+        self.answered = 0
+        self._lock = threading.Lock()
+        self._sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        self._sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        self._sock.bind((host, port))
+        self._sock.settimeout(0.2)
+        self._running = False
+
+    @property
+    def port(self):
+        return self._sock.getsockname()[1]
+
+    def _reply(self, request, received):
+        """Builds the reply to a request that reached the host at `received`."""
+        delay = max(0.0, self.delay + random.uniform(-self.jitter, self.jitter))
+        uplink = delay * self.asymmetry
+        t2 = received + self.offset + uplink     # as if the query had taken the uplink share
+        t3 = t2 + 0.0001
+        version = (request[0] >> 3) & 0x07
+        packet = bytes([(0 << 6) | (version << 3) | NTP_MODE_SERVER, self.stratum, request[2], 0xec])
+        packet += struct.pack('!II', 0x10, 0x10) + b'HRNS'   # root delay, root dispersion, reference id
+        packet += to_ntp(t2 - 1)                              # reference
+        packet += request[40:48]                              # origin, the client checks it
+        packet += to_ntp(t2) + to_ntp(t3)
+        return packet, delay
+
+    def _send(self, packet, address, delay):
+        with self._lock:
+            self.answered += 1
+        try:
+            self._sock.sendto(packet, address)
+        except OSError:
+            pass
+        if self.log:
+            self.log('%s:%d answered after %.1f ms' % (address[0], address[1], delay * 1000))
+
+    def serve(self):
+        self._running = True
+        while self._running:
+            try:
+                request, address = self._sock.recvfrom(512)
+            except socket.timeout:
+                continue
+            except OSError:
+                break
+            received = time.time()
+            if len(request) < NTP_PACKET_LEN or (request[0] & 0x07) != NTP_MODE_CLIENT:
+                continue
+            with self._lock:
+                self.requests += 1
+            if random.random() < self.loss:
+                with self._lock:
+                    self.dropped += 1
+                if self.log:
+                    self.log('%s:%d dropped' % address)
+                continue
+            packet, delay = self._reply(request, received)
+            timer = threading.Timer(delay, self._send, (packet, address, delay))
+            timer.daemon = True
+            timer.start()
+
+    def start(self):
+        """Serves from a background thread."""
+        thread = threading.Thread(target=self.serve, daemon=True)
+        thread.start()
+        return thread
+
+    def stop(self):
+        self._running = False
+
+
+def add_arguments(parser):
+    """Options shared with the harness."""
+    parser.add_argument('--port', type=int, default=12300, help='UDP port, default %(default)s')
+    parser.add_argument('--offset-ms', type=float, default=0.0, help='time served minus host time')
+    parser.add_argument('--delay-ms', type=float, default=0.0, help='round trip added to every reply')
+    parser.add_argument('--jitter-ms', type=float, default=0.0, help='delay varies this much either way')
+    parser.add_argument('--asymmetry', type=float, default=0.5,
+                        help='share of the delay on the way to the server, 0.5 is symmetric')
+    parser.add_argument('--loss', type=float, default=0.0, help='share of queries left unanswered, 0..1')
+    parser.add_argument('--stratum', type=int, default=2, help='stratum served, 16 is unsynchronized')
+
+
+def responder(args, log=None):
+    if not 0.0 <= args.loss <= 1.0 or not 0.0 <= args.asymmetry <= 1.0:
+        raise ValueError('--loss and --asymmetry take 0..1')
+    return Responder(host=getattr(args, 'host', '0.0.0.0'), port=args.port, offset_ms=args.offset_ms,
+                     delay_ms=args.delay_ms, jitter_ms=args.jitter_ms, asymmetry=args.asymmetry, loss=args.loss,
+                     stratum=args.stratum, log=log)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--host', default='0.0.0.0', help='address to bind, default %(default)s')
+    add_arguments(parser)
+    args = parser.parse_args()
+
+    try:
+        server = responder(args, log=lambda line: print(line, flush=True))
+    except (ValueError, OSError) as e:
+        print('ntp_responder: %s' % e, file=sys.stderr)
+        return 1
+    print('Serving on %s:%d, offset %+.1f ms, delay %.1f±%.1f ms, loss %.0f%%'
+          % (args.host, server.port, args.offset_ms, args.delay_ms, args.jitter_ms, args.loss * 100),
+          flush=True)
+    try:
+        server.serve()
+    except KeyboardInterrupt:
+        pass
+    print('%d requests, %d dropped' % (server.requests, server.dropped))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())